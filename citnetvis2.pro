@@ -6,7 +6,7 @@
 
 QT       += core gui network xml svg
 
-greaterThan(QT_MAJOR_VERSION, 4): QT += widgets
+greaterThan(QT_MAJOR_VERSION, 4): QT += widgets concurrent
 greaterThan(QT_MAJOR_VERSION, 4): DEFINES += "QT_DISABLE_DEPRECATED_BEFORE=0"
 
 RESOURCES += "icons.qrc"
@@ -20,6 +20,8 @@ TEMPLATE = app
 
 QMAKE_CXXFLAGS += -std=c++0x
 
+LIBS += -lz
+
 SOURCES += main.cpp\
         mainwindow.cpp \
     queryeditor.cpp \
@@ -43,7 +45,20 @@ SOURCES += main.cpp\
     opacityanimation.cpp \
     disappearanimation.cpp \
     nodeinfowidget.cpp \
-    persistentcheck.cpp
+    persistentcheck.cpp \
+    sparqlresultsparser.cpp \
+    publicationdiskcache.cpp \
+    identifier.cpp \
+    workerthread.cpp \
+    propertyassembler.cpp \
+    concurrencycontroller.cpp \
+    decompressor.cpp \
+    rdffileloader.cpp \
+    turtleparser.cpp \
+    querystatistics.cpp \
+    statisticswidget.cpp \
+    dateextractor.cpp \
+    layeredgraph.cpp
 
 HEADERS  += mainwindow.h \
     queryeditor.h \
@@ -71,4 +86,16 @@ HEADERS  += mainwindow.h \
     opacityanimation.h \
     disappearanimation.h \
     nodeinfowidget.h \
-    persistentcheck.h
+    persistentcheck.h \
+    sparqlresultsparser.h \
+    publicationdiskcache.h \
+    workerthread.h \
+    propertyassembler.h \
+    concurrencycontroller.h \
+    decompressor.h \
+    rdffileloader.h \
+    turtleparser.h \
+    querystatistics.h \
+    statisticswidget.h \
+    dateextractor.h \
+    layeredgraph.h
@@ -0,0 +1,127 @@
+#include "concurrencycontroller.h"
+
+#include <qmath.h>
+#include <QDebug>
+
+Q_GLOBAL_STATIC(ConcurrencyController, controller)
+
+static const int connectionsPerManager = 6; // Qt limitation
+static const int maxManagers = 8;
+static const qreal initialLimit = connectionsPerManager;
+static const qreal maxLimit = connectionsPerManager * maxManagers;
+
+static const qreal latencyWeight = 0.2;
+// Baseline slowly forgets old minima, batch sizes vary between queries
+static const qreal minLatencyDrift = 1.05;
+static const qreal latencyTolerance = 2.0;
+static const qreal latencyBackoff = 0.9;
+static const qreal overloadBackoff = 0.5;
+// Between decreases before the first response
+static const qint64 unknownLatencyInterval = 1000;
+
+ConcurrencyController::Endpoint::Endpoint()
+    : limit(initialLimit), latency(0), minLatency(0), lastDecrease(-1)
+{
+}
+
+ConcurrencyController::ConcurrencyController()
+{
+    clock.start();
+}
+
+ConcurrencyController::~ConcurrencyController()
+{
+    qDeleteAll(managers);
+}
+
+ConcurrencyController *ConcurrencyController::instance()
+{
+    return controller();
+}
+
+ConcurrencyController::Endpoint &
+ConcurrencyController::state(const QUrl &endpoint)
+{
+    return endpoints[endpoint.scheme() + "://" + endpoint.authority()];
+}
+
+QNetworkAccessManager *ConcurrencyController::manager(int i)
+{
+    while (managers.size() <= i) {
+        managers.append(new QNetworkAccessManager());
+    }
+    return managers[i];
+}
+
+int ConcurrencyController::limit(const QUrl &endpoint)
+{
+    return qMax(1, static_cast<int>(state(endpoint).limit));
+}
+
+QNetworkAccessManager *ConcurrencyController::started(const QUrl &endpoint)
+{
+    auto &e = state(endpoint);
+
+    int n = qMin(maxManagers, static_cast<int>(
+                     qCeil(e.limit / connectionsPerManager)));
+    QNetworkAccessManager *best = 0;
+    int bestLoad = 0;
+    for (int i = 0; i < n; i++) {
+        auto m = manager(i);
+        int load = e.inFlight.value(m);
+        if (!best || load < bestLoad) {
+            best = m;
+            bestLoad = load;
+        }
+    }
+
+    e.inFlight[best]++;
+    return best;
+}
+
+void ConcurrencyController::decrease(Endpoint &e, qreal factor)
+{
+    // At most once per round trip, so one burst of failures counts once
+    qint64 now = clock.elapsed();
+    qreal interval = e.latency > 0 ? e.latency : unknownLatencyInterval;
+    if (e.lastDecrease >= 0 && now - e.lastDecrease < interval) {
+        return;
+    }
+    e.limit = qMax<qreal>(1, e.limit * factor);
+    e.lastDecrease = now;
+}
+
+void ConcurrencyController::finished(const QUrl &endpoint,
+                                     QNetworkAccessManager *m,
+                                     qint64 firstByteMsecs, Outcome outcome)
+{
+    auto &e = state(endpoint);
+    e.inFlight[m]--;
+
+    switch (outcome) {
+    case Success:
+        e.latency = (e.latency > 0)
+                ? e.latency * (1 - latencyWeight) +
+                  firstByteMsecs * latencyWeight
+                : firstByteMsecs;
+        e.minLatency = (e.minLatency > 0)
+                ? qMin<qreal>(firstByteMsecs, e.minLatency * minLatencyDrift)
+                : firstByteMsecs;
+        e.minLatency = qMax<qreal>(1, e.minLatency);
+
+        if (e.latency > latencyTolerance * e.minLatency) {
+            decrease(e, latencyBackoff);
+        } else {
+            e.limit = qMin(maxLimit, e.limit + 1 / e.limit);
+        }
+        break;
+
+    case Overloaded:
+        decrease(e, overloadBackoff);
+        qDebug() << "Endpoint overloaded, parallel queries:" << e.limit;
+        break;
+
+    default:
+        break;
+    }
+}
@@ -0,0 +1,57 @@
+#ifndef CONCURRENCYCONTROLLER_H
+#define CONCURRENCYCONTROLLER_H
+
+#include <QUrl>
+#include <QHash>
+#include <QVector>
+#include <QElapsedTimer>
+#include <QNetworkAccessManager>
+
+// Per-endpoint limit on queries in flight, adjusted with AIMD: grows by
+// about one per round trip while time to first byte stays near the best
+// seen, is cut by half on overload (503, 429, timeouts) and slightly when
+// it climbs. Transfer time isn't counted, it grows with the batch size. Each access manager opens at most six connections per host,
+// so queries are spread over several managers when the limit is higher.
+class ConcurrencyController
+{
+public:
+    enum Outcome
+    {
+        Success,
+        Overloaded,
+        Failed,
+        Cancelled
+    };
+
+    ConcurrencyController();
+    ~ConcurrencyController();
+
+    static ConcurrencyController *instance();
+
+    int limit(const QUrl &endpoint);
+
+    QNetworkAccessManager *started(const QUrl &endpoint);
+    void finished(const QUrl &endpoint, QNetworkAccessManager *,
+                  qint64 firstByteMsecs, Outcome);
+
+private:
+    struct Endpoint
+    {
+        Endpoint();
+
+        qreal limit;
+        qreal latency, minLatency;
+        qint64 lastDecrease;
+        QHash<QNetworkAccessManager *, int> inFlight;
+    };
+
+    Endpoint &state(const QUrl &);
+    void decrease(Endpoint &, qreal factor);
+    QNetworkAccessManager *manager(int);
+
+    QVector<QNetworkAccessManager *> managers;
+    QHash<QString, Endpoint> endpoints;
+    QElapsedTimer clock;
+};
+
+#endif // CONCURRENCYCONTROLLER_H
@@ -1,42 +1,173 @@
 #include "dataset.h"
 
 #include "sparqltokenizer.h"
+#include "publicationdiskcache.h"
+#include "propertyassembler.h"
+#include "workerthread.h"
+#include "rdffileloader.h"
 
 #include <QTimer>
+#include <QCache>
+#include <QCryptographicHash>
+#include <QDataStream>
 #include <QDebug>
 
 struct CacheInfo
 {
-    QString queryBegin, queryEnd, dateRegEx;
-    QUrl endpointUrl;
+    QByteArray context;
     Identifier id;
 
     CacheInfo(const Dataset &ds, const Identifier &id)
-        : queryBegin(ds.queryBegin), queryEnd(ds.queryEnd),
-          dateRegEx(ds.dateSubstring.pattern()), endpointUrl(ds.endpoint),
-          id(id)
+        : context(ds.cacheContext), id(id)
     {
     }
+
+    // Endpoint, generated query and date regex, shared by memory
+    // and disk caches
+    static QByteArray makeContext(const Dataset &ds)
+    {
+        QCryptographicHash hash(QCryptographicHash::Sha1);
+        hash.addData(ds.endpoint.toEncoded());
+        hash.addData(ds.queryBegin.toUtf8());
+        hash.addData(ds.queryEnd.toUtf8());
+        hash.addData(ds.dateSubstring.pattern().toUtf8());
+        return hash.result();
+    }
 };
 
 bool operator ==(const CacheInfo &a, const CacheInfo &b)
 {
-    return (a.queryBegin == b.queryBegin) && (a.queryEnd == b.queryEnd) &&
-            (a.dateRegEx == b.dateRegEx) && (a.endpointUrl == b.endpointUrl) &&
-            (a.id == b.id);
+    return (a.id == b.id) && (a.context == b.context);
 }
 
 uint qHash(const CacheInfo &info)
 {
-    return qHash(info.queryBegin) + qHash(info.queryEnd) + qHash(info.dateRegEx)
-            + qHash(info.endpointUrl) + qHash(info.id);
+    return qHash(info.context) + qHash(info.id);
 }
 
-typedef QHash<CacheInfo, Publication> PublicationCache;
+static int publicationCost(const Publication &p)
+{
+    int cost = sizeof(Publication) + p.iri().toString().size() * sizeof(QChar)
+            + p.title.size() * sizeof(QChar);
+    foreach (auto i, p.dates) {
+        cost += sizeof(QString) + i.size() * sizeof(QChar);
+    }
+    // References share string data with the publications they point to
+    cost += p.references.size() * (sizeof(Identifier) + sizeof(void*) * 2);
+    return cost;
+}
+
+// LRU of publications shared by all datasets, bounded by approximate
+// memory use in bytes
+class PublicationCache
+{
+public:
+    PublicationCache() : hits(0), misses(0), evictions(0)
+    {
+        lru.setMaxCost(128 * 1024 * 1024);
+    }
+
+    bool find(const CacheInfo &key, Publication &p)
+    {
+        auto found = lru.object(key);
+        if (!found) {
+            misses++;
+            return false;
+        }
+        hits++;
+        p = *found;
+        return true;
+    }
+
+    bool contains(const CacheInfo &key) const
+    {
+        return lru.contains(key);
+    }
+
+    void insert(const CacheInfo &key, const Publication &p)
+    {
+        int expected = lru.size() + (lru.contains(key) ? 0 : 1);
+        if (lru.insert(key, new Publication(p), publicationCost(p))) {
+            evictions += expected - lru.size();
+        }
+    }
+
+    void setMaxCost(int bytes)
+    {
+        int before = lru.size();
+        lru.setMaxCost(bytes);
+        evictions += before - lru.size();
+    }
+
+    Dataset::CacheStatistics statistics() const
+    {
+        Dataset::CacheStatistics s;
+        s.hits = hits;
+        s.misses = misses;
+        s.evictions = evictions;
+        s.publications = lru.size();
+        s.bytes = lru.totalCost();
+        return s;
+    }
+
+private:
+    QCache<CacheInfo, Publication> lru;
+    qint64 hits, misses, evictions;
+};
+
 Q_GLOBAL_STATIC(PublicationCache, cache)
 
+void Dataset::setCacheBudget(int bytes)
+{
+    cache()->setMaxCost(bytes);
+}
+
+Dataset::CacheStatistics Dataset::cacheStatistics()
+{
+    return cache()->statistics();
+}
+
+// Limits for a single property query. Endpoints time out on huge FILTERs,
+// so the queue is split into batches and spread over all parallel slots.
+static const int maxBatchIris = 200;
+static const int maxBatchBytes = 32 * 1024;
+// Smallest batch while the queue still grows, as a fraction of the largest
+static const int minBatchFraction = 4;
+// Percent-encoded "?s=<>||" and "<> "
+static const int filterIriOverhead = 19;
+static const int valuesIriOverhead = 7;
+
+// A failed batch is retried once after retryDelay, then split in halves,
+// each wait doubling. Single publications get up to maxAttempts.
+static const int maxAttempts = 4;
+static const int retryDelay = 1000;
+
+// Batch size learned from bisection, per endpoint host for the session
+typedef QHash<QString, int> BatchSizes;
+Q_GLOBAL_STATIC(BatchSizes, safeBatchSizes)
+
+static QString endpointKey(const QUrl &endpoint)
+{
+    return endpoint.scheme() + "://" + endpoint.authority();
+}
+
+static int safeBatchSize(const QUrl &endpoint)
+{
+    return safeBatchSizes()->value(endpointKey(endpoint), maxBatchIris);
+}
+
+// Dump chunks parsed ahead of the assembler
+static const int maxPendingFileBatches = 2;
+
+// Progress updates per second, more only restart the overlay for nothing
+static const int progressRate = 30;
+
 Dataset::Dataset(QObject *parent)
-    : QObject(parent), queryInfo(QStringRef()), errorSet(false)
+    : QObject(parent), mainQuery(0), queryInfo(QStringRef()),
+      errorSet(false), assembler(0), pendingBatches(0), stopped(false),
+      lastSplit(0), fileLoader(0), fileLoading(false), readPending(false),
+      bytesReceived(0), bytesDecoded(0), dateMisses(0), queriesSent(0),
+      loadMsecs(0)
 {
 }
 
@@ -44,11 +175,23 @@ Dataset::Dataset(const QUrl &endpointUrl, const QString &query,
                  const QString &hasDate, const QString &hasTitle,
                  const QString &citesPublicationReference,
                  const QString &dateRegEx, bool loadRecursive,
-                 QObject *parent)
-    : QObject(parent), endpoint(endpointUrl),
-      queryInfo(&query), dateSubstring(dateRegEx), errorSet(false),
+                 bool useValues, const Dataset *previous, QObject *parent)
+    : QObject(parent), mainQuery(0), endpoint(endpointUrl),
+      queryText(query), queryInfo(&queryText), dateSubstring(dateRegEx),
+      errorSet(false),
+      useValues(useValues), assembler(0), pendingBatches(0), stopped(false),
+      lastSplit(0),
+      fileLoader(0), fileLoading(false), readPending(false), bytesReceived(0),
+      bytesDecoded(0), dateMisses(0), queriesSent(0), loadMsecs(0),
       loadRecursive(loadRecursive)
 {
+    loadTimer.start();
+    retryTimer.setSingleShot(true);
+    connect(&retryTimer, SIGNAL(timeout()), SLOT(retryDue()));
+    progressTimer.setSingleShot(true);
+    progressTimer.setInterval(1000 / progressRate);
+    connect(&progressTimer, SIGNAL(timeout()), SLOT(flushProgress()));
+
     if (!endpointUrl.isValid()) setError("Invalid endpoint URL");
 
     if (!hasDate.isEmpty()) checkPredicate(hasDate);
@@ -64,29 +207,285 @@ Dataset::Dataset(const QUrl &endpointUrl, const QString &query,
     if (!hasTitle.isEmpty()) hasTitleResolved = queryInfo.resolve(hasTitle);
     referenceResolved = queryInfo.resolve(citesPublicationReference);
 
-    auto mainQuery = createQuery(query);
+    assembler = new PropertyAssembler(hasDateResolved, hasTitleResolved,
+                                      referenceResolved, dateSubstring);
+    assembler->moveToThread(WorkerThread::instance());
+    connect(assembler, SIGNAL(assembled(QList<Publication>,int,QString)),
+            SLOT(propertiesAssembled(QList<Publication>,int,QString)));
+
+    if (endpointUrl.isLocalFile()) {
+        loadFile(endpointUrl.toLocalFile());
+        return;
+    }
+
+    mainQuery = createQuery(query);
     connect(mainQuery, SIGNAL(results(SparqlQuery::Results)),
             SLOT(addPublications(SparqlQuery::Results)));
     mainQuery->exec();
 
+    if (useValues) {
+        patternBegin.append("VALUES ?s {");
+
+        patternEnd.append("} VALUES ?p {");
+        if (!hasDateResolved.isEmpty()) {
+            patternEnd.append(hasDateResolved);
+            patternEnd.append(" ");
+        }
+        if (!hasTitleResolved.isEmpty()) {
+            patternEnd.append(hasTitleResolved);
+            patternEnd.append(" ");
+        }
+        patternEnd.append(referenceResolved);
+        patternEnd.append("} ?s ?p ?o.");
+    } else {
+        patternBegin.append("?s ?p ?o. FILTER(");
+
+        patternEnd.append(") FILTER(");
+        if (!hasDateResolved.isEmpty()) {
+            patternEnd.append("?p=");
+            patternEnd.append(hasDateResolved);
+            patternEnd.append("||");
+        }
+        if (!hasTitleResolved.isEmpty()) {
+            patternEnd.append("?p=");
+            patternEnd.append(hasTitleResolved);
+            patternEnd.append("||");
+        }
+        patternEnd.append("?p=");
+        patternEnd.append(referenceResolved);
+        patternEnd.append(")");
+    }
+
     queryBegin.append("SELECT ?s ?p ?o\n");
     queryBegin.append(queryInfo.dataset());
-    queryBegin.append("\nWHERE{?s ?p ?o. FILTER(");
+    queryBegin.append("\nWHERE{");
+    queryBegin.append(patternBegin);
+    queryEnd.append(patternEnd);
+    queryEnd.append("}");
+
+    cacheContext = CacheInfo::makeContext(*this);
 
-    queryEnd.append(") FILTER(");
-    if (!hasDateResolved.isEmpty()) {
-        queryEnd.append("?p=");
-        queryEnd.append(hasDateResolved);
-        queryEnd.append("||");
+    // Main query results arrive through the event loop, after this
+    if (previous && previous->isFinished() && !previous->hasError() &&
+            previous->cacheContext == cacheContext)
+    {
+        previousPublications = previous->currentPublications;
+    }
+}
+
+Dataset::~Dataset()
+{
+    if (assembler) {
+        assembler->deleteLater();
+    }
+    if (fileLoader) {
+        fileLoader->deleteLater();
+    }
+}
+
+// Every subject with one of the predicates is a publication, the main
+// query is only used for its prefixes. Chunks are requested one at a time
+// as the assembler catches up, so the dump is never held in memory.
+void Dataset::loadFile(const QString &fileName)
+{
+    QSet<QString> predicates;
+    foreach (auto i, QStringList() << hasDateResolved << hasTitleResolved
+             << referenceResolved)
+    {
+        if (!i.isEmpty()) {
+            predicates.insert(i.mid(1, i.size() - 2));
+        }
     }
-    if (!hasTitleResolved.isEmpty()) {
-        queryEnd.append("?p=");
-        queryEnd.append(hasTitleResolved);
-        queryEnd.append("||");
+
+    fileLoader = new RdfFileLoader(fileName, predicates);
+    fileLoader->moveToThread(WorkerThread::instance());
+    connect(fileLoader, SIGNAL(triples(SparqlQuery::Results,bool,QString)),
+            SLOT(fileTriples(SparqlQuery::Results,bool,QString)));
+
+    fileLoading = true;
+    requestFileData();
+}
+
+void Dataset::requestFileData()
+{
+    if (!fileLoading || readPending ||
+            pendingBatches >= maxPendingFileBatches)
+    {
+        return;
     }
-    queryEnd.append("?p=");
-    queryEnd.append(referenceResolved);
-    queryEnd.append(")}");
+
+    readPending = true;
+    QMetaObject::invokeMethod(fileLoader, "readChunk", Qt::QueuedConnection);
+}
+
+void Dataset::fileTriples(const SparqlQuery::Results &results, bool end,
+                          const QString &err)
+{
+    bool prevFinished = isFinished();
+    readPending = false;
+
+    if (!fileLoading) {
+        // Aborted while the chunk was parsed
+        checkFinished(prevFinished);
+        return;
+    }
+
+    if (end) {
+        fileLoading = false;
+    }
+    if (!err.isEmpty()) {
+        setError(err);
+    } else if (!results.isEmpty()) {
+        addProperties(results);
+    }
+
+    requestFileData();
+    checkFinished(prevFinished);
+}
+
+static const quint32 snapshotMagic = 0x434e5644; // "CNVD"
+static const quint32 snapshotVersion = 2;
+static const QDataStream::Version snapshotStreamVersion = QDataStream::Qt_4_6;
+
+typedef QHash<Identifier, quint32> SnapshotTable;
+
+static void addToTable(SnapshotTable &table, QList<Identifier> &strings,
+                       const Identifier &id)
+{
+    if (!table.contains(id)) {
+        table.insert(id, strings.size());
+        strings.append(id);
+    }
+}
+
+static Identifier fromTable(const QVector<Identifier> &strings, quint32 i,
+                            QDataStream &in)
+{
+    if (i >= quint32(strings.size())) {
+        in.setStatus(QDataStream::ReadCorruptData);
+        return Identifier();
+    }
+    return strings[i];
+}
+
+// Every IRI is written once into a string table, publications refer to it
+// by position
+bool Dataset::saveSnapshot(QIODevice *device) const
+{
+    QDataStream out(device);
+    out.setVersion(snapshotStreamVersion);
+
+    out << snapshotMagic << snapshotVersion;
+    out << endpoint.toEncoded() << queryText << hasDateResolved
+        << hasTitleResolved << referenceResolved << dateSubstring.pattern()
+        << loadRecursive;
+
+    SnapshotTable table;
+    QList<Identifier> strings;
+    for (auto &p : currentPublications) {
+        addToTable(table, strings, p.iri());
+        for (auto &ref : p.references) {
+            addToTable(table, strings, ref);
+        }
+    }
+
+    out << quint32(strings.size());
+    for (auto &id : strings) {
+        out << id.toString().toUtf8();
+    }
+
+    out << quint32(currentPublications.size());
+    for (auto &p : currentPublications) {
+        out << table[p.iri()] << p.recurse << p.title.toUtf8() << p.digest;
+        out << quint32(p.dates.size());
+        for (auto &date : p.dates) {
+            out << date.toUtf8();
+        }
+        out << quint32(p.references.size());
+        for (auto &ref : p.references) {
+            out << table[ref];
+        }
+    }
+
+    return out.status() == QDataStream::Ok;
+}
+
+bool Dataset::loadSnapshot(QIODevice *device)
+{
+    Q_ASSERT(currentPublications.isEmpty());
+
+    QDataStream in(device);
+    in.setVersion(snapshotStreamVersion);
+
+    quint32 magic = 0, version = 0;
+    in >> magic >> version;
+    if (magic != snapshotMagic) {
+        setError("Not a dataset snapshot");
+        return false;
+    }
+    if (version < 1 || version > snapshotVersion) {
+        setError("Unsupported snapshot version " + QString::number(version));
+        return false;
+    }
+
+    QByteArray endpointEncoded;
+    QString datePattern;
+    in >> endpointEncoded >> queryText >> hasDateResolved >> hasTitleResolved
+       >> referenceResolved >> datePattern >> loadRecursive;
+    endpoint = QUrl::fromEncoded(endpointEncoded);
+    queryInfo = SparqlQueryInfo(&queryText);
+    dateSubstring.setPattern(datePattern);
+
+    quint32 count = 0;
+    in >> count;
+    QVector<Identifier> strings;
+    for (quint32 i = 0; i < count && in.status() == QDataStream::Ok; i++) {
+        QByteArray s;
+        in >> s;
+        strings.append(Identifier(QString::fromUtf8(s)));
+    }
+
+    in >> count;
+    for (quint32 i = 0; i < count && in.status() == QDataStream::Ok; i++) {
+        quint32 iri = 0, n = 0;
+        bool recurse = false;
+        QByteArray title;
+        in >> iri >> recurse >> title;
+
+        Publication p(fromTable(strings, iri, in), recurse);
+        p.title = QString::fromUtf8(title);
+        // Without a digest the next refresh fetches the publication again
+        if (version >= 2) {
+            in >> p.digest;
+        }
+
+        in >> n;
+        for (quint32 j = 0; j < n && in.status() == QDataStream::Ok; j++) {
+            QByteArray date;
+            in >> date;
+            p.dates.insert(QString::fromUtf8(date));
+        }
+        in >> n;
+        for (quint32 j = 0; j < n && in.status() == QDataStream::Ok; j++) {
+            quint32 ref = 0;
+            in >> ref;
+            p.references.insert(fromTable(strings, ref, in));
+        }
+
+        currentPublications.insert(p.iri(), p);
+        dataReceivedFor.insert(p.iri());
+    }
+
+    if (in.status() != QDataStream::Ok) {
+        currentPublications.clear();
+        dataReceivedFor.clear();
+        setError("Truncated or corrupt snapshot");
+        return false;
+    }
+
+    qDebug() << "Loaded" << currentPublications.size()
+             << "publications from snapshot";
+    return true;
 }
 
 void Dataset::checkPredicate(const QString &pred)
@@ -100,10 +499,30 @@ void Dataset::checkPredicate(const QString &pred)
 
 void Dataset::abort()
 {
+    stopped = true;
     publicationQueue.clear();
+    queuedSince.clear();
     foreach (auto i, inProgress) {
         i->abort();
     }
+    // Pending retries are dropped by runQueries()
+    if (!retryQueue.isEmpty()) {
+        retryTimer.start(0);
+    }
+
+    if (fileLoading) {
+        fileLoading = false;
+        if (!readPending) {
+            // Finish through the same path as a chunk that arrived late
+            readPending = true;
+            QMetaObject::invokeMethod(this, "fileTriples",
+                                      Qt::QueuedConnection,
+                                      Q_ARG(SparqlQuery::Results,
+                                            SparqlQuery::Results()),
+                                      Q_ARG(bool, true),
+                                      Q_ARG(QString, QString()));
+        }
+    }
 }
 
 void Dataset::clear()
@@ -118,26 +537,190 @@ void Dataset::queryFinished()
 
     auto query = qobject_cast<SparqlQuery*>(sender());
     inProgress.remove(query);
+    if (query == mainQuery) {
+        mainQuery = 0;
+    }
+
+    bytesReceived += query->compressedBytes();
+    bytesDecoded += query->uncompressedBytes();
+
+    auto batch = batchQueries.find(query);
+    auto revalidation = revalidationQueries.find(query);
+
+    QueryStatistics::Record record;
+    record.timeToFirstByte = query->timeToFirstByte();
+    record.latency = query->latency();
+    record.rows = query->rowCount();
+    record.compressedBytes = query->compressedBytes();
+    record.uncompressedBytes = query->uncompressedBytes();
+    record.failed = query->hasError();
+    if (batch != batchQueries.end()) {
+        record.queueWait = batch->queueWait;
+        record.publications = batch->iris.size();
+    }
+    stats.add(record);
 
     if (query->hasError()) {
-        setError(query->errorString());
+        if (batch != batchQueries.end() && !stopped) {
+            retryBatch(*batch, query->errorString());
+        } else if (revalidation != revalidationQueries.end() && !stopped) {
+            qWarning() << "Revalidation failed:" << query->errorString()
+                       << "- keeping" << revalidation->size()
+                       << "publications as they were";
+        } else {
+            setError(query->errorString());
+        }
+    }
+    if (batch != batchQueries.end()) {
+        splitFinished(batch->split, !query->hasError());
+        batchQueries.erase(batch);
+    }
+    if (revalidation != revalidationQueries.end()) {
+        // Publications without rows lost all their properties
+        if (!query->hasError()) {
+            foreach (auto i, *revalidation) {
+                Identifier id(i);
+                if (currentPublications.value(id, Publication(id)).digest) {
+                    publicationChanged(id);
+                }
+            }
+        }
+        revalidationQueries.erase(revalidation);
     }
     query->deleteLater();
 
-    if (inProgress.size() < SparqlQuery::maxParallelQueries()) {
-        runQueries();
+    runQueries();
+    checkFinished(prevFinished);
+}
+
+void Dataset::retryBatch(PropertyBatch batch, const QString &err)
+{
+    batch.attempt++;
+    qint64 now = loadTimer.elapsed();
+    // Halves back off too, an overloaded endpoint gets no more queries
+    // right after a failure just because they are smaller
+    int delay = retryDelay << qMin(batch.attempt - 1, maxAttempts - 1);
+
+    if (batch.attempt > 1 && batch.iris.size() > 1) {
+        int half = (batch.iris.size() + 1) / 2;
+        qWarning() << "Property query failed:" << err << "- splitting"
+                   << batch.iris.size() << "publications, retrying in"
+                   << delay << "ms";
+
+        Split split;
+        split.size = half;
+        split.pending = 2;
+        split.failed = false;
+        splits.insert(++lastSplit, split);
+
+        PropertyBatch first, second;
+        first.iris = batch.iris.mid(0, half);
+        second.iris = batch.iris.mid(half);
+        first.attempt = second.attempt = batch.attempt;
+        first.split = second.split = lastSplit;
+        first.due = second.due = now + delay;
+        first.queued = second.queued = now + delay;
+        retryQueue << first << second;
+    } else if (batch.attempt < maxAttempts) {
+        qWarning() << "Property query failed:" << err << "- retrying in"
+                   << delay << "ms";
+
+        batch.due = batch.queued = now + delay;
+        // Its split already counts this failure
+        batch.split = 0;
+        retryQueue << batch;
+    } else {
+        qWarning() << "Giving up on" << batch.iris.first() << ":" << err;
+        failed.insert(Identifier(batch.iris.first()));
     }
+}
 
+void Dataset::splitFinished(int id, bool succeeded)
+{
+    auto split = splits.find(id);
+    if (split == splits.end()) {
+        return;
+    }
+
+    split->failed = split->failed || !succeeded;
+    if (--split->pending > 0) {
+        return;
+    }
+
+    // Both halves went through, so the size was the problem
+    if (!split->failed && split->size < safeBatchSize(endpoint)) {
+        QString key = endpointKey(endpoint);
+        safeBatchSizes()->insert(key, split->size);
+        qDebug() << "Batch size for" << key << "is now" << split->size;
+    }
+    splits.erase(split);
+}
+
+void Dataset::retryDue()
+{
+    bool prevFinished = isFinished();
+    runQueries();
+    checkFinished(prevFinished);
+}
+
+void Dataset::scheduleRetries()
+{
+    // Batches already due wait for a free slot, not for the timer
+    qint64 now = loadTimer.elapsed(), next = -1;
+    foreach (auto i, retryQueue) {
+        if (i.due > now && (next < 0 || i.due < next)) {
+            next = i.due;
+        }
+    }
+    if (next < 0) {
+        retryTimer.stop();
+    } else {
+        retryTimer.start(next - now);
+    }
+}
+
+void Dataset::checkFinished(bool prevFinished)
+{
     if (!prevFinished && isFinished()) {
         qDebug() << "Nothing more to load";
 
-        if (!hasError()) {
-            cache()->clear();
+        if (!previousPublications.isEmpty() && !hasError()) {
+            computeDiff();
+        }
+
+        if (!hasError() && !fileLoader) {
+            QList<Publication> fetched;
             for (auto p : currentPublications) {
-                cache()->insert(CacheInfo(*this, p.iri()), p);
+                if (!fromCache.contains(p.iri()) &&
+                        !failed.contains(p.iri()))
+                {
+                    cache()->insert(CacheInfo(*this, p.iri()), p);
+                    fetched.append(p);
+                }
             }
+            PublicationDiskCache::instance()->insert(cacheContext, fetched);
+        }
+
+        auto cacheStats = cacheStatistics();
+        qDebug() << "Cache hits" << cacheStats.hits << "misses"
+                 << cacheStats.misses << "evictions" << cacheStats.evictions
+                 << "size" << cacheStats.publications << "publications,"
+                 << cacheStats.bytes << "bytes";
+        if (dateMisses > 0) {
+            qWarning() << dateMisses << "dates didn't match the date pattern"
+                       << dateSubstring.pattern();
+        }
+        if (loadTimer.isValid()) {
+            loadMsecs = loadTimer.elapsed();
         }
+        stats.setWallTime(loadMsecs);
+        qDebug() << "Loaded" << currentPublications.size() << "publications in"
+                 << loadMsecs << "ms," << queriesSent << "queries,"
+                 << bytesReceived << "bytes received," << bytesDecoded
+                 << "bytes decoded";
 
+        progressTimer.stop();
+        flushProgress();
         emit finished();
     }
 }
@@ -147,14 +730,42 @@ SparqlQuery *Dataset::createQuery(const QString &text)
     auto q = new SparqlQuery(endpoint, text, this);
     connect(q, SIGNAL(finished()), SLOT(queryFinished()));
     inProgress.insert(q);
+    queriesSent++;
 
     emitProgress();
     return q;
 }
 
+// Only arms the timer, so callers on hot paths stay cheap
 void Dataset::emitProgress()
 {
-    emit progress(dataReceivedFor.size(), currentPublications.size());
+    if (!progressTimer.isActive()) {
+        progressTimer.start();
+    }
+}
+
+void Dataset::flushProgress()
+{
+    emit progress(currentProgress());
+}
+
+Dataset::Progress Dataset::currentProgress() const
+{
+    Progress p;
+    p.done = dataReceivedFor.size();
+    p.total = currentPublications.size();
+    p.queriesInFlight = inProgress.size();
+    p.queued = publicationQueue.size() + revalidationQueue.size();
+    for (auto &i : retryQueue) {
+        p.queued += i.iris.size();
+    }
+    p.bytesReceived = bytesReceived;
+    p.bytesDecoded = bytesDecoded;
+    foreach (auto q, inProgress) {
+        p.bytesReceived += q->compressedBytes();
+        p.bytesDecoded += q->uncompressedBytes();
+    }
+    return p;
 }
 
 void Dataset::setError(const QString &err)
@@ -175,128 +786,398 @@ QHash<Identifier, Publication>::Iterator
 Dataset::queryPublication(const Identifier &id, bool recurse)
 {
     auto found = currentPublications.find(id);
-    if (found == currentPublications.end()) {
-        auto cached = cache()->find(CacheInfo(*this, id));
-        if (cached == cache()->end()) {
-            qDebug() << "Cache miss" << id;
-            found = currentPublications.insert(id, Publication(id, recurse));
-            publicationQueue.append(id.toString());
-        } else {
+    if (found == currentPublications.end() && fileLoader) {
+        // The dump is read once, there is nothing to query
+        found = currentPublications.insert(id, Publication(id, recurse));
+        dataReceivedFor.insert(id);
+    } else if (found == currentPublications.end() &&
+               previousPublications.contains(id))
+    {
+        // Kept until the revalidation says otherwise
+        found = currentPublications.insert(id, previousPublications.value(id));
+        found->recurse = false;
+        dataReceivedFor.insert(id);
+        revalidationQueue.append(id.toString());
+    } else if (found == currentPublications.end()) {
+        Publication cachedPublication(id);
+        if (findCached(id, cachedPublication)) {
             qDebug() << "Cache hit" << id;
-            found = currentPublications.insert(id, *cached);
+            found = currentPublications.insert(id, cachedPublication);
             found->recurse = false;
             dataReceivedFor.insert(id);
+            fromCache.insert(id);
+        } else {
+            qDebug() << "Cache miss" << id;
+            found = currentPublications.insert(id, Publication(id, recurse));
+            publicationQueue.append(id.toString());
+            queuedSince.append(loadTimer.elapsed());
         }
     }
     return found;
 }
 
+// Disk reads only come from findCachedBatch()
+bool Dataset::findCached(const Identifier &id, Publication &publication)
+{
+    CacheInfo info(*this, id);
+    if (cache()->find(info, publication)) {
+        return true;
+    }
+
+    auto hit = diskHits.find(id);
+    if (hit != diskHits.end()) {
+        publication = *hit;
+        diskHits.erase(hit);
+        cache()->insert(info, publication);
+        return true;
+    }
+    return false;
+}
+
+// Looks up on disk what a main query chunk or a property batch is about
+// to query, in one pass through the cache file
+void Dataset::findCachedBatch(const QVector<Identifier> &ids)
+{
+    QVector<Identifier> wanted;
+    if (!fileLoader) {
+        foreach (auto id, ids) {
+            if (!currentPublications.contains(id) &&
+                    !previousPublications.contains(id) &&
+                    !cache()->contains(CacheInfo(*this, id)))
+            {
+                wanted.append(id);
+            }
+        }
+    }
+    diskHits = PublicationDiskCache::instance()->find(cacheContext, wanted);
+}
+
 void Dataset::addPublications(const SparqlQuery::Results &results)
 {
-    foreach (auto i, results) {
-        if (i.size() != 1) {
+    if (results.columnCount() != 1) {
+        setError("Query must return a list of publications");
+        return;
+    }
+
+    QVector<QString> iris;
+    iris.reserve(results.rowCount());
+    for (int row = 0; row < results.rowCount(); row++) {
+        auto &iri = results.at(row, 0);
+        if (iri.isNull()) {
             setError("Query must return a list of publications");
             return;
         }
+        iris.append(iri);
+    }
+    auto ids = Identifier::fromStrings(iris);
 
-        auto found = queryPublication(Identifier(i.begin().value()), true);
+    // References of cached publications are looked up after the chunk
+    findCachedBatch(ids);
+    QVector<Identifier> references;
+    foreach (auto id, ids) {
+        auto found = queryPublication(id, true);
         if (!found->recurse) {
             found->recurse = true;
             if (loadRecursive) {
                 foreach (auto ref, found->references) {
-                    queryPublication(ref);
+                    references.append(ref);
                 }
             }
         }
     }
 
+    findCachedBatch(references);
+    foreach (auto ref, references) {
+        queryPublication(ref);
+    }
+    diskHits.clear();
+
     qDebug() << publicationQueue.size() << "new publications";
 
-    if (inProgress.size() < SparqlQuery::maxParallelQueries()) {
-        runQueries();
-    }
+    runQueries();
     emitProgress();
 }
 
 void Dataset::runQueries()
 {
-    if (publicationQueue.isEmpty()) {
-        return;
+    int maxParallel = SparqlQuery::maxParallelQueries(endpoint);
+
+    if (stopped) {
+        retryQueue.clear();
+        revalidationQueue.clear();
     }
 
-    QString query(queryBegin);
-    foreach (auto i, publicationQueue) {
-        query.append("?s=<");
-        query.append(i);
-        query.append(">||");
+    qint64 now = loadTimer.elapsed();
+    for (auto i = retryQueue.begin();
+         i != retryQueue.end() && inProgress.size() < maxParallel; )
+    {
+        if (i->due > now) {
+            i++;
+            continue;
+        }
+        PropertyBatch batch = *i;
+        i = retryQueue.erase(i);
+        startBatch(batch);
     }
-    if (query.endsWith("||")) {
-        query.remove(query.length() - 2, 2);
+
+    // Spreading the queue over all slots only pays off once it is
+    // complete. Before that it would turn a few large requests into many
+    // round trips for one or two IRIs each.
+    int maxIris = qMin(maxBatchIris, safeBatchSize(endpoint));
+    int minIris = queueCanGrow() ? qMax(1, maxIris / minBatchFraction) : 1;
+    while (publicationQueue.size() >= minIris &&
+           inProgress.size() < maxParallel)
+    {
+        int freeSlots = maxParallel - inProgress.size();
+        int batchSize = (publicationQueue.size() + freeSlots - 1) / freeSlots;
+        runBatch(qBound(minIris, batchSize, maxIris));
     }
-    query.append(queryEnd);
 
-    publicationQueue.clear();
+    // Fetching new publications goes first
+    while (!revalidationQueue.isEmpty() && inProgress.size() < maxParallel) {
+        runRevalidation(maxBatchIris);
+    }
+
+    scheduleRetries();
+}
+
+// Something in flight may still queue publications: the main query, rows
+// waiting for the assembler, or properties that can reference new ones
+bool Dataset::queueCanGrow() const
+{
+    return mainQuery || pendingBatches > 0 ||
+            (loadRecursive &&
+             (!batchQueries.isEmpty() || !retryQueue.isEmpty()));
+}
+
+// Number of IRIs from the head of the queue that fit into one query
+int Dataset::batchLength(const QStringList &queue, int maxIris) const
+{
+    int overhead = useValues ? valuesIriOverhead : filterIriOverhead;
+    int bytes = 0;
+    int n = 0;
+    for (; n < maxIris && n < queue.size(); n++) {
+        int iriBytes = QUrl::toPercentEncoding(queue[n]).size() + overhead;
+        if (n > 0 && bytes + iriBytes > maxBatchBytes) {
+            break;
+        }
+        bytes += iriBytes;
+    }
+    return n;
+}
+
+// Contents of VALUES ?s {} or FILTER()
+QString Dataset::subjectList(const QStringList &iris) const
+{
+    QString list;
+    for (int n = 0; n < iris.size(); n++) {
+        const QString &iri = iris[n];
+        if (useValues) {
+            list.append("<");
+            list.append(iri);
+            list.append("> ");
+        } else {
+            if (n > 0) {
+                list.append("||");
+            }
+            list.append("?s=<");
+            list.append(iri);
+            list.append(">");
+        }
+    }
+    return list;
+}
+
+void Dataset::runBatch(int maxIris)
+{
+    int n = batchLength(publicationQueue, maxIris);
+
+    PropertyBatch batch;
+    batch.queued = queuedSince.first();
+    batch.iris = publicationQueue.mid(0, n);
+    publicationQueue.erase(publicationQueue.begin(),
+                           publicationQueue.begin() + n);
+    queuedSince.erase(queuedSince.begin(), queuedSince.begin() + n);
+    startBatch(batch);
+}
+
+void Dataset::startBatch(PropertyBatch batch)
+{
+    batch.queueWait = loadTimer.elapsed() - batch.queued;
+
+    QString query(queryBegin);
+    query.append(subjectList(batch.iris));
+    query.append(queryEnd);
 
     auto q = createQuery(query);
     connect(q, SIGNAL(results(SparqlQuery::Results)),
             SLOT(addProperties(SparqlQuery::Results)));
+    batchQueries.insert(q, batch);
     q->exec();
 }
 
-void Dataset::addProperties(const SparqlQuery::Results &results)
+// The endpoint hashes every property row the way PropertyAssembler does
+// and returns the hashes, the sum is taken here. GROUP_CONCAT has no
+// defined order and rows reach the assembler in chunks, so an ordered
+// digest of the whole group couldn't be rebuilt on this side.
+void Dataset::runRevalidation(int maxIris)
+{
+    int n = batchLength(revalidationQueue, maxIris);
+    QStringList iris = revalidationQueue.mid(0, n);
+    revalidationQueue.erase(revalidationQueue.begin(),
+                            revalidationQueue.begin() + n);
+
+    QString query("SELECT ?s "
+                  "(GROUP_CONCAT(MD5(CONCAT(STR(?p),\" \",STR(?o)))) AS ?h)\n");
+    query.append(queryInfo.dataset());
+    query.append("\nWHERE{");
+    query.append(patternBegin);
+    query.append(subjectList(iris));
+    query.append(patternEnd);
+    query.append("} GROUP BY ?s");
+
+    auto q = createQuery(query);
+    connect(q, SIGNAL(results(SparqlQuery::Results)),
+            SLOT(rowDigests(SparqlQuery::Results)));
+    revalidationQueries.insert(q, iris);
+    q->exec();
+}
+
+void Dataset::rowDigests(const SparqlQuery::Results &results)
 {
-    static const QString subject("s"), predicate("p"), object("o");
+    auto query = qobject_cast<SparqlQuery*>(sender());
+    auto pending = revalidationQueries.find(query);
+    int s = results.column("s"), h = results.column("h");
+    if (pending == revalidationQueries.end() || s < 0 || h < 0) {
+        return;
+    }
+
+    for (int row = 0; row < results.rowCount(); row++) {
+        auto &iri = results.at(row, s);
+        pending->removeOne(iri);
 
-    foreach (auto i, results) {
-        if (i.size() != 3 || !i.contains(subject) || !i.contains(predicate) ||
-                !i.contains(object))
+        // Hex MD5 per row, the first 64 bits are summed
+        quint64 digest = 0;
+        auto hashes = results.at(row, h).split(' ', QString::SkipEmptyParts);
+        foreach (auto i, hashes) {
+            digest += i.left(16).toULongLong(0, 16);
+        }
+
+        Identifier id(iri);
+        auto found = currentPublications.constFind(id);
+        if (found != currentPublications.constEnd() &&
+                found->digest != digest)
         {
-            setError("Unexpected data. "
-                     "Wrong generated query or endpoint problems");
-            return;
+            publicationChanged(id);
         }
+    }
+}
 
-        Identifier id(i[subject]);
-        dataReceivedFor.insert(id);
-        auto j = currentPublications.find(id);
-        if (j == currentPublications.end()) {
-            setError("Unexpected subject " + id.toString() +
-                     ". Wrong generated query or endpoint problems");
-            return;
+// Drops the reused data and fetches the publication again
+void Dataset::publicationChanged(const Identifier &id)
+{
+    auto found = currentPublications.find(id);
+    if (found == currentPublications.end() || changed.contains(id)) {
+        return;
+    }
+
+    *found = Publication(id, found->recurse);
+    dataReceivedFor.remove(id);
+    changed.insert(id);
+    publicationQueue.append(id.toString());
+    queuedSince.append(loadTimer.elapsed());
+}
+
+void Dataset::computeDiff()
+{
+    int added = 0, removed = 0;
+    for (auto i = currentPublications.constBegin();
+         i != currentPublications.constEnd(); i++)
+    {
+        if (!previousPublications.contains(i.key())) {
+            added++;
+        }
+    }
+    for (auto i = previousPublications.constBegin();
+         i != previousPublications.constEnd(); i++)
+    {
+        if (!currentPublications.contains(i.key())) {
+            removed++;
         }
+    }
+    previousPublications.clear();
+
+    qDebug() << "Refresh:" << added << "added," << changed.size()
+             << "changed," << removed << "removed";
+}
+
+void Dataset::addProperties(const SparqlQuery::Results &results)
+{
+    pendingBatches++;
+    QMetaObject::invokeMethod(assembler, "addProperties", Qt::QueuedConnection,
+                              Q_ARG(SparqlQuery::Results, results));
+}
 
-        QString pred("<");
-        pred.append(i[predicate]);
-        pred.append(">");
+void Dataset::propertiesAssembled(const QList<Publication> &batch,
+                                  int misses, const QString &err)
+{
+    bool prevFinished = isFinished();
+    pendingBatches--;
+    dateMisses += misses;
 
-        if (!hasDateResolved.isEmpty() && pred == hasDateResolved) {
-            auto date = i[object];
-            int idx = date.lastIndexOf(dateSubstring);
+    if (!err.isEmpty()) {
+        setError(err);
+    }
 
-            if (idx == -1) {
-                qWarning() << "Can't find date substring in" << date;
-            } else {
-                date = date.mid(idx, dateSubstring.matchedLength());
+    // References the loop below queries
+    if (loadRecursive) {
+        QVector<Identifier> references;
+        foreach (auto p, batch) {
+            auto j = currentPublications.constFind(p.iri());
+            if (j != currentPublications.constEnd() && j->recurse) {
+                foreach (auto ref, p.references) {
+                    references.append(ref);
+                }
             }
-            j->dates.insert(date);
-        } else if (!hasTitleResolved.isEmpty() && pred == hasTitleResolved) {
-            j->title = i[object];
-        } else if (pred == referenceResolved) {
-            Identifier ref(i[object]);
-            j->references.insert(ref);
-
-            if (j->recurse && loadRecursive) {
+        }
+        findCachedBatch(references);
+    }
+
+    foreach (auto p, batch) {
+        if (hasError()) {
+            break;
+        }
+
+        dataReceivedFor.insert(p.iri());
+        // Every subject of a dump is a publication of its own
+        auto j = fileLoader ? queryPublication(p.iri(), true)
+                            : currentPublications.find(p.iri());
+        if (fileLoader) {
+            j->recurse = true;
+        } else if (j == currentPublications.end()) {
+            setError("Unexpected subject " + p.iri().toString() +
+                     ". Wrong generated query or endpoint problems");
+            break;
+        }
+
+        if (!p.title.isEmpty()) {
+            j->title = p.title;
+        }
+        j->dates.unite(p.dates);
+        j->references.unite(p.references);
+        j->digest += p.digest;
+
+        // queryPublication() may invalidate j
+        if (j->recurse && loadRecursive) {
+            foreach (auto ref, p.references) {
                 queryPublication(ref);
             }
-        } else {
-            setError("Unexpected predicate " + pred +
-                     ". Wrong generated query or endpoint problems");
-            return;
         }
     }
+    diskHits.clear();
 
-    if (inProgress.size() < SparqlQuery::maxParallelQueries()) {
-        runQueries();
-    }
+    runQueries();
+    requestFileData();
     emitProgress();
+    checkFinished(prevFinished);
 }
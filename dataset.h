@@ -5,10 +5,17 @@
 #include <QSet>
 #include <QHash>
 #include <QRegExp>
+#include <QElapsedTimer>
+#include <QTimer>
+#include <QIODevice>
 
 #include "sparqlquery.h"
 #include "sparqlqueryinfo.h"
 #include "publication.h"
+#include "querystatistics.h"
+
+class PropertyAssembler;
+class RdfFileLoader;
 
 class Dataset : public QObject
 {
@@ -20,11 +27,16 @@ public:
             const QString &hasDate, const QString &hasTitle,
             const QString &citesPublicationReference,
             const QString &dateRegEx, bool loadRecursive,
+            bool useValues = false, const Dataset *previous = 0,
             QObject *parent = 0);
+    virtual ~Dataset();
 
     bool isFinished() const
     {
-        return inProgress.isEmpty() && publicationQueue.isEmpty();
+        return inProgress.isEmpty() && publicationQueue.isEmpty() &&
+                retryQueue.isEmpty() && revalidationQueue.isEmpty() &&
+                pendingBatches == 0 &&
+                !fileLoading && !readPending;
     }
 
     bool hasError() const { return errorSet; }
@@ -36,6 +48,47 @@ public:
     }
 
     const SparqlQueryInfo &queryParameters() const { return queryInfo; }
+    const QUrl &endpointUrl() const { return endpoint; }
+    // Predicates as <IRI>, date and title ones may be empty
+    const QString &datePredicate() const { return hasDateResolved; }
+    const QString &titlePredicate() const { return hasTitleResolved; }
+    const QString &referencePredicate() const { return referenceResolved; }
+
+    // Versioned binary file with publications and query parameters.
+    // Load into an empty dataset; errors are reported like load errors.
+    bool saveSnapshot(QIODevice *) const;
+    bool loadSnapshot(QIODevice *);
+
+    // Publications whose properties couldn't be fetched even after retries
+    const QSet<Identifier> &failedPublications() const { return failed; }
+
+    // Totals over finished queries, see SparqlQuery::compressedBytes()
+    qint64 compressedBytes() const { return bytesReceived; }
+    qint64 uncompressedBytes() const { return bytesDecoded; }
+    int queryCount() const { return queriesSent; }
+    // Milliseconds from construction until finished()
+    qint64 loadTime() const { return loadMsecs; }
+    const QueryStatistics &statistics() const { return stats; }
+
+    // Load state as shown while loading. Queued counts publications
+    // waiting for property queries, bytes include queries still running.
+    struct Progress
+    {
+        int done, total;
+        int queriesInFlight, queued;
+        qint64 bytesReceived, bytesDecoded;
+    };
+    Progress currentProgress() const;
+
+    struct CacheStatistics
+    {
+        qint64 hits, misses, evictions;
+        int publications, bytes;
+    };
+
+    // In-memory publication cache shared by all datasets
+    static void setCacheBudget(int bytes);
+    static CacheStatistics cacheStatistics();
 
 public slots:
     void abort();
@@ -43,39 +96,127 @@ public slots:
 
 signals:
     void finished();
-    void progress(int done, int total);
+    // At most progressRate times a second, and once more before finished()
+    void progress(const Dataset::Progress &);
 
 private slots:
     void queryFinished();
 
     void addPublications(const SparqlQuery::Results &);
     void addProperties(const SparqlQuery::Results &);
+    void propertiesAssembled(const QList<Publication> &, int dateMisses,
+                             const QString &);
+    void fileTriples(const SparqlQuery::Results &, bool end,
+                     const QString &error);
+    void rowDigests(const SparqlQuery::Results &);
 
     void runQueries();
+    void retryDue();
+    void flushProgress();
 
 private:
+    struct PropertyBatch
+    {
+        PropertyBatch()
+            : attempt(0), split(0), due(0), queued(0), queueWait(0) { }
+
+        QStringList iris;
+        int attempt;
+        // Split this batch is a half of, 0 if none
+        int split;
+        qint64 due;
+        // Since when the oldest publication waits, how long it waited
+        qint64 queued, queueWait;
+    };
+
     SparqlQuery *createQuery(const QString &);
+    bool queueCanGrow() const;
+    int batchLength(const QStringList &queue, int maxIris) const;
+    QString subjectList(const QStringList &iris) const;
+    void runBatch(int maxIris);
+    void startBatch(PropertyBatch);
+    void runRevalidation(int maxIris);
+    void publicationChanged(const Identifier &);
+    void computeDiff();
+    void retryBatch(PropertyBatch, const QString &error);
+    void splitFinished(int split, bool succeeded);
+    void scheduleRetries();
+    void loadFile(const QString &fileName);
+    void requestFileData();
     void emitProgress();
+    void checkFinished(bool prevFinished);
     void setError(const QString &);
     void checkPredicate(const QString &);
     QHash<Identifier, Publication>::Iterator
     queryPublication(const Identifier &, bool recurse = false);
+    bool findCached(const Identifier &, Publication &);
+    void findCachedBatch(const QVector<Identifier> &);
 
     QSet<SparqlQuery*> inProgress;
+    // Until it finishes, publications keep arriving
+    SparqlQuery *mainQuery;
 
     QUrl endpoint;
     QString hasDateResolved, hasTitleResolved, referenceResolved;
+    QString queryText;
     SparqlQueryInfo queryInfo;
     QRegExp dateSubstring;
 
     bool errorSet;
     QString error;
 
+    bool useValues;
     QString queryBegin, queryEnd;
+    // WHERE clause of property queries around the subject list
+    QString patternBegin, patternEnd;
+    QByteArray cacheContext;
+
+    PropertyAssembler *assembler;
+    int pendingBatches;
     QStringList publicationQueue;
+    QList<qint64> queuedSince;
+
+    // Failed property queries are retried with backoff, then bisected
+    QHash<SparqlQuery*, PropertyBatch> batchQueries;
+    QList<PropertyBatch> retryQueue;
+    QTimer retryTimer;
+    QSet<Identifier> failed;
+    bool stopped;
+
+    // Halves of split batches. The endpoint's batch size is lowered only
+    // when both halves succeed, a single bad publication doesn't count.
+    struct Split
+    {
+        int size, pending;
+        bool failed;
+    };
+    QHash<int, Split> splits;
+    int lastSplit;
+
+    // Refresh: publications of the previous run are reused when the digest
+    // of their rows on the endpoint didn't change
+    QHash<Identifier, Publication> previousPublications;
+    QStringList revalidationQueue;
+    QHash<SparqlQuery*, QStringList> revalidationQueries;
+    QSet<Identifier> changed;
+
+    // Local dump instead of an endpoint, see loadFile()
+    RdfFileLoader *fileLoader;
+    bool fileLoading, readPending;
 
     QHash<Identifier, Publication> currentPublications;
     QSet<Identifier> dataReceivedFor;
+    QSet<Identifier> fromCache;
+    // Disk cache hits of the chunk being added, see findCachedBatch()
+    QHash<Identifier, Publication> diskHits;
+
+    qint64 bytesReceived, bytesDecoded;
+    qint64 dateMisses;
+    int queriesSent;
+    QElapsedTimer loadTimer;
+    qint64 loadMsecs;
+    QTimer progressTimer;
+    QueryStatistics stats;
 
     bool loadRecursive;
 
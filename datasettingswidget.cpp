@@ -1,6 +1,7 @@
 #include "datasettingswidget.h"
 
 #include <QFormLayout>
+#include <QIntValidator>
 
 DataSettingsWidget::DataSettingsWidget(QWidget *parent) :
     QWidget(parent)
@@ -31,6 +32,24 @@ DataSettingsWidget::DataSettingsWidget(QWidget *parent) :
     recursiveCheck->setValue(true);
     layout->addRow("Show &referenced nodes", recursiveCheck);
 
+    valuesCheck = new QCheckBox(this);
+    layout->addRow("Use VALUES in &property queries", valuesCheck);
+    connect(endpointUrlEdit, SIGNAL(textChanged(QString)),
+            SLOT(endpointChanged()));
+    connect(valuesCheck, SIGNAL(clicked(bool)), SLOT(valuesClicked(bool)));
+
+    cacheDaysEdit = new PersistentField("CacheDays", "7", this);
+    cacheDaysEdit->setValidator(new QIntValidator(0, 3650, cacheDaysEdit));
+    layout->addRow("Keep cached data (days)", cacheDaysEdit);
+
+    cacheSizeEdit = new PersistentField("CacheSize", "64", this);
+    cacheSizeEdit->setValidator(new QIntValidator(0, 65536, cacheSizeEdit));
+    layout->addRow("Disk cache size (MB)", cacheSizeEdit);
+
+    memoryCacheEdit = new PersistentField("MemoryCacheSize", "128", this);
+    memoryCacheEdit->setValidator(new QIntValidator(0, 2047, memoryCacheEdit));
+    layout->addRow("Memory cache size (MB)", memoryCacheEdit);
+
     barycenterCheck = new PersistentCheck("UseBarycenter", this);
     barycenterCheck->setValue(false);
     layout->addRow("&Barycenter heuristic", barycenterCheck);
@@ -42,4 +61,40 @@ DataSettingsWidget::DataSettingsWidget(QWidget *parent) :
     randomizeCheck = new PersistentCheck("Randomize", this);
     randomizeCheck->setValue(false);
     layout->addRow("Random insertion", randomizeCheck);
+
+    layoutRunsEdit = new PersistentField("LayoutRuns", "1", this);
+    layoutRunsEdit->setValidator(new QIntValidator(1, 64, layoutRunsEdit));
+    layout->addRow("Layout runs", layoutRunsEdit);
+
+    layoutSeedEdit = new PersistentField("LayoutSeed", "0", this);
+    layoutSeedEdit->setValidator(new QIntValidator(0, 1 << 30, layoutSeedEdit));
+    layout->addRow("Layout random seed", layoutSeedEdit);
+}
+
+void DataSettingsWidget::saveState(QSettings *settings) const
+{
+    settings->setValue("UseValues", valuesEndpoints);
+}
+
+// Runs before the endpoint field loads its own state
+void DataSettingsWidget::loadState(const QSettings *settings)
+{
+    valuesEndpoints = settings->value("UseValues").toMap();
+    auto endpoint = settings->value(endpointUrlEdit->objectName(),
+                                    endpointUrl()).toString();
+    valuesCheck->setChecked(valuesEndpoints.value(endpoint).toBool());
+}
+
+void DataSettingsWidget::endpointChanged()
+{
+    valuesCheck->setChecked(valuesEndpoints.value(endpointUrl()).toBool());
+}
+
+void DataSettingsWidget::valuesClicked(bool checked)
+{
+    if (checked) {
+        valuesEndpoints.insert(endpointUrl(), true);
+    } else {
+        valuesEndpoints.remove(endpointUrl());
+    }
 }
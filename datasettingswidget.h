@@ -2,11 +2,14 @@
 #define DATASETTINGSWIDGET_H
 
 #include <QWidget>
+#include <QCheckBox>
+#include <QVariantMap>
 
 #include "persistentfield.h"
 #include "persistentcheck.h"
+#include "persistentwidget.h"
 
-class DataSettingsWidget : public QWidget
+class DataSettingsWidget : public QWidget, public PersistentWidget
 {
     Q_OBJECT
 public:
@@ -18,15 +21,34 @@ public:
     QString titlePredicate() const { return titleEdit->text(); }
     QString referencePredicate() const { return referenceEdit->text(); }
     bool loadReferences() const { return recursiveCheck->value(); }
+    bool useValuesQuery() const { return valuesCheck->isChecked(); }
+    int cacheDays() const { return cacheDaysEdit->text().toInt(); }
+    int cacheSizeMb() const { return cacheSizeEdit->text().toInt(); }
+    int memoryCacheMb() const { return memoryCacheEdit->text().toInt(); }
     bool useBarycenterHeuristic() const { return barycenterCheck->value(); }
     bool useSlowAlgorithm() const { return slowCheck->value(); }
     bool randomize() const { return randomizeCheck->value(); }
+    int layoutRuns() const { return layoutRunsEdit->text().toInt(); }
+    quint32 layoutSeed() const { return layoutSeedEdit->text().toUInt(); }
+
+    virtual void saveState(QSettings *) const;
+    virtual void loadState(const QSettings *);
+
+private slots:
+    void endpointChanged();
+    void valuesClicked(bool);
 
 private:
     PersistentField *endpointUrlEdit, *dateEdit, *titleEdit, *referenceEdit,
-    *dateRegExEdit;
+    *dateRegExEdit, *cacheDaysEdit, *cacheSizeEdit, *memoryCacheEdit,
+    *layoutRunsEdit, *layoutSeedEdit;
     PersistentCheck *recursiveCheck, *barycenterCheck, *slowCheck,
     *randomizeCheck;
+
+    // VALUES support differs between stores, so the check box follows
+    // the endpoint URL. Only endpoints with VALUES enabled are stored.
+    QCheckBox *valuesCheck;
+    QVariantMap valuesEndpoints;
 };
 
 #endif // DATASETTINGSWIDGET_H
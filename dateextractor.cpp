@@ -0,0 +1,96 @@
+#include "dateextractor.h"
+
+#include <QRegExp>
+
+// Bounds the memo on loads with many distinct literals
+static const int maxMemoSize = 64 * 1024;
+
+// Number of digits if the pattern is nothing but a run of [0-9]. \d
+// isn't scanned, it matches every Unicode decimal digit.
+static int digitRunLength(const QString &pattern)
+{
+    static const QRegExp counted("^\\[0-9\\]\\{([1-9][0-9]?)\\}$");
+    static const QRegExp repeated("^(?:\\[0-9\\])+$");
+
+    QRegExp c(counted);
+    if (c.exactMatch(pattern)) {
+        return c.cap(1).toInt();
+    }
+    if (repeated.exactMatch(pattern)) {
+        return pattern.count("[0-9]");
+    }
+    return 0;
+}
+
+DateExtractor::DateExtractor(const QString &pattern)
+    : digits(digitRunLength(pattern)), re(pattern), missCount(0),
+      memoHitCount(0)
+{
+#if QT_VERSION >= QT_VERSION_CHECK(5,0,0)
+    re.optimize();
+#endif
+}
+
+bool DateExtractor::extract(const QString &literal, QString &date)
+{
+    auto found = memo.constFind(literal);
+    if (found != memo.constEnd()) {
+        memoHitCount++;
+        date = found->date;
+        if (!found->found) {
+            missCount++;
+        }
+        return found->found;
+    }
+
+    Entry e;
+    e.found = digits > 0 ? scanDigits(literal, e.date) : match(literal, e.date);
+    if (!e.found) {
+        e.date = literal;
+        missCount++;
+    }
+
+    if (memo.size() >= maxMemoSize) {
+        memo.clear();
+    }
+    memo.insert(literal, e);
+
+    date = e.date;
+    return e.found;
+}
+
+// Same result as lastIndexOf() with the pattern: the rightmost start
+bool DateExtractor::scanDigits(const QString &literal, QString &date) const
+{
+    const QChar *s = literal.constData();
+    int run = 0;
+    for (int i = literal.size() - 1; i >= 0; i--) {
+        ushort c = s[i].unicode();
+        run = (c >= '0' && c <= '9') ? run + 1 : 0;
+        if (run == digits) {
+            date = literal.mid(i, digits);
+            return true;
+        }
+    }
+    return false;
+}
+
+bool DateExtractor::match(const QString &literal, QString &date) const
+{
+#if QT_VERSION >= QT_VERSION_CHECK(5,0,0)
+    int idx = literal.lastIndexOf(re);
+    if (idx < 0) {
+        return false;
+    }
+    auto m = re.match(literal, idx, QRegularExpression::NormalMatch,
+                      QRegularExpression::AnchoredMatchOption);
+    date = m.captured();
+#else
+    int idx = literal.lastIndexOf(re);
+    if (idx < 0) {
+        return false;
+    }
+    date = literal.mid(idx, re.matchedLength());
+#endif
+    return true;
+}
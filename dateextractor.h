@@ -0,0 +1,48 @@
+#ifndef DATEEXTRACTOR_H
+#define DATEEXTRACTOR_H
+
+#include <QString>
+#include <QHash>
+#if QT_VERSION >= QT_VERSION_CHECK(5,0,0)
+#   include <QRegularExpression>
+#else
+#   include <QRegExp>
+#endif
+
+// Finds the last match of the date pattern in a literal. Plain ASCII
+// digit runs like [0-9]{4} are scanned directly, other patterns go
+// through a precompiled regular expression. Results are remembered per
+// literal.
+class DateExtractor
+{
+public:
+    explicit DateExtractor(const QString &pattern);
+
+    // Sets date to the match, or to the whole literal if there is none
+    bool extract(const QString &literal, QString &date);
+
+    qint64 misses() const { return missCount; }
+    qint64 memoHits() const { return memoHitCount; }
+
+private:
+    struct Entry
+    {
+        QString date;
+        bool found;
+    };
+
+    bool scanDigits(const QString &literal, QString &date) const;
+    bool match(const QString &literal, QString &date) const;
+
+    int digits;
+#if QT_VERSION >= QT_VERSION_CHECK(5,0,0)
+    QRegularExpression re;
+#else
+    mutable QRegExp re;
+#endif
+
+    QHash<QString, Entry> memo;
+    qint64 missCount, memoHitCount;
+};
+
+#endif // DATEEXTRACTOR_H
@@ -0,0 +1,125 @@
+#include "decompressor.h"
+
+#include <string.h>
+
+static const int outputChunk = 64 * 1024;
+
+QByteArray Decompressor::acceptEncoding()
+{
+    return "gzip, deflate";
+}
+
+Decompressor::Encoding Decompressor::encoding(const QByteArray &contentEncoding)
+{
+    auto e = contentEncoding.trimmed().toLower();
+    if (e == "gzip" || e == "x-gzip") {
+        return Gzip;
+    }
+    if (e == "deflate") {
+        return Deflate;
+    }
+    return Identity;
+}
+
+Decompressor::Decompressor(Encoding e)
+    : enc(e), initialized(false), raw(false), streamEnd(false)
+{
+    if (enc == Gzip) {
+        // Detect zlib or gzip header
+        init(MAX_WBITS + 32);
+    }
+}
+
+Decompressor::~Decompressor()
+{
+    if (initialized) {
+        inflateEnd(&stream);
+    }
+}
+
+void Decompressor::init(int windowBits)
+{
+    if (initialized) {
+        inflateEnd(&stream);
+    }
+    memset(&stream, 0, sizeof(stream));
+    initialized = (inflateInit2(&stream, windowBits) == Z_OK);
+    if (!initialized) {
+        error = "Can't initialize zlib";
+    }
+}
+
+// "deflate" should be zlib-wrapped, but some servers send raw deflate.
+// A zlib header is CMF with method 8 and at most a 32K window, then FLG
+// making CMF * 256 + FLG a multiple of 31. Gzip headers pass as well.
+static bool hasHeader(const QByteArray &bytes)
+{
+    auto cmf = static_cast<uchar>(bytes[0]);
+    auto flg = static_cast<uchar>(bytes[1]);
+    if (cmf == 0x1f && flg == 0x8b) {
+        return true;
+    }
+    return (cmf & 0x0f) == 8 && (cmf >> 4) <= 7 && (cmf * 256 + flg) % 31 == 0;
+}
+
+bool Decompressor::decompress(const QByteArray &in, QByteArray &out)
+{
+    if (enc == Identity) {
+        out.append(in);
+        return true;
+    }
+
+    // Decided once, before any output, however the input is chunked
+    QByteArray data = in;
+    if (enc == Deflate && !initialized && error.isEmpty()) {
+        header.append(in);
+        if (header.size() < 2) {
+            return true;
+        }
+        raw = !hasHeader(header);
+        init(raw ? -MAX_WBITS : MAX_WBITS + 32);
+        data = header;
+        header.clear();
+    }
+    if (!initialized) {
+        return false;
+    }
+
+    stream.next_in = reinterpret_cast<Bytef *>(const_cast<char *>(
+                                                   data.constData()));
+    stream.avail_in = data.size();
+
+    char buffer[outputChunk];
+    forever {
+        if (streamEnd) {
+            // Gzip files may have several members (bgzip, cat a.gz b.gz).
+            // Raw deflate has no framing for that, the rest is ignored.
+            if (stream.avail_in == 0 || raw) {
+                return true;
+            }
+            if (inflateReset(&stream) != Z_OK) {
+                error = "Can't reset zlib";
+                return false;
+            }
+            streamEnd = false;
+        }
+
+        stream.next_out = reinterpret_cast<Bytef *>(buffer);
+        stream.avail_out = sizeof(buffer);
+
+        int ret = inflate(&stream, Z_NO_FLUSH);
+        if (ret != Z_OK && ret != Z_STREAM_END && ret != Z_BUF_ERROR) {
+            error = stream.msg ? QString::fromLatin1(stream.msg)
+                               : QString("Corrupt compressed data");
+            return false;
+        }
+
+        out.append(buffer, sizeof(buffer) - stream.avail_out);
+
+        if (ret == Z_STREAM_END) {
+            streamEnd = true;
+        } else if (stream.avail_out != 0) {
+            return true;
+        }
+    }
+}
@@ -0,0 +1,49 @@
+#ifndef DECOMPRESSOR_H
+#define DECOMPRESSOR_H
+
+#include <QByteArray>
+#include <QString>
+
+#include <zlib.h>
+
+// Incremental gzip/deflate decoder for reply bodies. Data is inflated
+// chunk by chunk as it arrives, the whole body is never buffered.
+class Decompressor
+{
+public:
+    enum Encoding
+    {
+        Identity,
+        Gzip,
+        Deflate
+    };
+
+    static QByteArray acceptEncoding();
+    static Encoding encoding(const QByteArray &contentEncoding);
+
+    explicit Decompressor(Encoding);
+    ~Decompressor();
+
+    // Appends decoded data to out, returns false on corrupt input
+    bool decompress(const QByteArray &in, QByteArray &out);
+    const QString &errorString() const { return error; }
+    // The compressed stream is complete, input that stops before this
+    // is truncated
+    bool atEnd() const { return enc == Identity || streamEnd; }
+
+private:
+    Q_DISABLE_COPY(Decompressor)
+
+    void init(int windowBits);
+
+    Encoding enc;
+    z_stream stream;
+    bool initialized;
+    bool raw;
+    bool streamEnd;
+    // Deflate input until the header tells zlib from raw deflate
+    QByteArray header;
+    QString error;
+};
+
+#endif // DECOMPRESSOR_H
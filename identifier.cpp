@@ -0,0 +1,85 @@
+#include "identifier.h"
+
+#include <QMutex>
+#include <QMutexLocker>
+
+// Strings live in fixed-size blocks that never move, so references
+// returned by lookup() stay valid while the pool grows, and lookups
+// need no lock.
+static const int blockBits = 12;
+static const quint32 blockSize = 1 << blockBits;
+static const int maxBlocks = 1 << 16;
+
+struct IdentifierPool
+{
+    IdentifierPool() : size(1)
+    {
+        blocks[0] = new QString[blockSize];
+        for (int i = 1; i < maxBlocks; i++) {
+            blocks[i] = 0;
+        }
+    }
+
+    ~IdentifierPool()
+    {
+        for (int i = 0; i < maxBlocks && blocks[i]; i++) {
+            delete[] blocks[i];
+        }
+    }
+
+    QMutex mutex;
+    QHash<QString, quint32> ids;
+    QString *blocks[maxBlocks];
+    quint32 size;
+};
+
+Q_GLOBAL_STATIC(IdentifierPool, pool)
+
+// Called with the pool locked
+static quint32 insert(IdentifierPool *p, const QString &s)
+{
+    auto found = p->ids.constFind(s);
+    if (found != p->ids.constEnd()) {
+        return *found;
+    }
+
+    quint32 idx = p->size;
+    Q_ASSERT((idx >> blockBits) < maxBlocks);
+    auto &block = p->blocks[idx >> blockBits];
+    if (!block) {
+        block = new QString[blockSize];
+    }
+    block[idx & (blockSize - 1)] = s;
+    p->ids.insert(s, idx);
+    p->size++;
+    return idx;
+}
+
+quint32 Identifier::intern(const QString &s)
+{
+    if (s.isEmpty()) {
+        return 0;
+    }
+
+    auto p = pool();
+    QMutexLocker lock(&p->mutex);
+    return insert(p, s);
+}
+
+QVector<Identifier> Identifier::fromStrings(const QVector<QString> &strings)
+{
+    QVector<Identifier> result(strings.size());
+    auto p = pool();
+    QMutexLocker lock(&p->mutex);
+    for (int i = 0; i < strings.size(); i++) {
+        if (!strings[i].isEmpty()) {
+            result[i].idx = insert(p, strings[i]);
+        }
+    }
+    return result;
+}
+
+const QString &Identifier::lookup(quint32 idx)
+{
+    return pool()->blocks[idx >> blockBits][idx & (blockSize - 1)];
+}
@@ -3,28 +3,38 @@
 
 #include <QString>
 #include <QHash>
+#include <QVector>
 
+// IRI interned in a global pool. Each distinct string gets a dense index
+// once, so hashing and equality are integer operations. Index 0 is the
+// empty identifier. Strings are never removed from the pool.
 class Identifier
 {
 public:
-    Identifier(const QString &s = QString()) : str(s), hash(qHash(s)) { }
+    Identifier(const QString &s = QString()) : idx(intern(s)) { }
 
-    const QString &toString() const { return str; }
-    uint getHash() const { return hash; }
+    const QString &toString() const { return lookup(idx); }
+    quint32 index() const { return idx; }
+    uint getHash() const { return idx; }
 
-    operator bool() const { return !str.isEmpty(); }
+    operator bool() const { return idx != 0; }
 
+    // Interns all strings under one lock, for batches of results
+    static QVector<Identifier> fromStrings(const QVector<QString> &);
+
+    // String order: indices depend on which IRI arrived first, and
+    // sorting by them would make layouts differ between loads
     static int compare(const Identifier &a, const Identifier &b)
     {
-        if (a.hash < b.hash) return -1;
-        if (a.hash > b.hash) return 1;
-
-        return QString::compare(a.str, b.str);
+        if (a.idx == b.idx) return 0;
+        return QString::compare(a.toString(), b.toString());
     }
 
 private:
-    QString str;
-    uint hash;
+    static quint32 intern(const QString &);
+    static const QString &lookup(quint32);
+
+    quint32 idx;
 };
 
 inline uint qHash(const Identifier &s) { return s.getHash(); }
@@ -35,19 +45,27 @@ OStream &operator <<(OStream &s, const Identifier &str)
     return s << str.toString();
 }
 
+inline bool operator ==(const Identifier &a, const Identifier &b)
+{
+    return a.index() == b.index();
+}
+
+inline bool operator !=(const Identifier &a, const Identifier &b)
+{
+    return a.index() != b.index();
+}
+
 #define IDENTIFIER_MAKEOP(op) \
 inline bool operator op(const Identifier &a, const Identifier &b) \
 { \
     return Identifier::compare(a, b) op 0; \
 }
 
-IDENTIFIER_MAKEOP(==)
-IDENTIFIER_MAKEOP(!=)
 IDENTIFIER_MAKEOP(<)
 IDENTIFIER_MAKEOP(>)
 IDENTIFIER_MAKEOP(<=)
 IDENTIFIER_MAKEOP(>=)
 
-#undef HASHEDSTRING_MAKEOP
+#undef IDENTIFIER_MAKEOP
 
 #endif // IDENTIFIER_H
@@ -0,0 +1,150 @@
+#include "layeredgraph.h"
+
+#include <QtAlgorithms>
+
+void LayeredGraph::build(const QList<QVector<VNodeRef> > &nodes)
+{
+    layers.resize(nodes.size());
+
+    for (int l = 0; l < layers.size(); l++) {
+        auto &layer = layers[l];
+        layer.nodes = nodes[l];
+
+        int n = layer.nodes.size();
+        layer.order.resize(n);
+        layer.position.resize(n);
+        layer.moveable.resize(n);
+        layer.y.fill(0, n);
+        layer.sizes.fill(0, n);
+        layer.newY.fill(0, n);
+        for (int v = 0; v < n; v++) {
+            layer.nodes[v]->indexInLayer = v;
+            layer.order[v] = v;
+            layer.position[v] = v;
+            layer.moveable[v] = layer.nodes[v]->moveable;
+        }
+    }
+
+    for (int l = 0; l < layers.size(); l++) {
+        auto &layer = layers[l];
+        for (int side = 0; side < 2; side++) {
+            int adjacent = side ? l + 1 : l - 1;
+            auto &offsets = layer.offsets[side];
+            auto &adjacency = layer.adjacency[side];
+
+            offsets.resize(layer.count() + 1);
+            adjacency.resize(0);
+            offsets[0] = 0;
+            for (int v = 0; v < layer.count(); v++) {
+                for (auto &r : layer.nodes[v]->neighbors[side]) {
+                    // Nodes removed from the scene keep stale indices
+                    int idx = r->indexInLayer;
+                    if (adjacent >= 0 && adjacent < layers.size() &&
+                            idx >= 0 && idx < layers[adjacent].count() &&
+                            layers[adjacent].nodes[idx] == r)
+                    {
+                        adjacency.append(idx);
+                    }
+                }
+                offsets[v + 1] = adjacency.size();
+            }
+            layer.sorted[side].resize(adjacency.size());
+        }
+    }
+}
+
+void LayeredGraph::sortNeighbors(int l, int side)
+{
+    auto &layer = layers[l];
+    if (layer.adjacency[side].isEmpty()) {
+        return;
+    }
+
+    const int *position = layers[side ? l + 1 : l - 1].position.constData();
+    const int *adjacency = layer.adjacency[side].constData();
+    const int *offsets = layer.offsets[side].constData();
+    int *sorted = layer.sorted[side].data();
+
+    for (int v = 0; v < layer.count(); v++) {
+        for (int k = offsets[v]; k < offsets[v + 1]; k++) {
+            sorted[k] = position[adjacency[k]];
+        }
+        qSort(sorted + offsets[v], sorted + offsets[v + 1]);
+    }
+}
+
+QVector<VNodeRef> LayeredGraph::nodesInOrder(int l) const
+{
+    auto &layer = layers[l];
+    QVector<VNodeRef> result(layer.count());
+    for (int p = 0; p < layer.count(); p++) {
+        result[p] = layer.nodes[layer.order[p]];
+    }
+    return result;
+}
+
+int LayeredGraph::Layer::positionCount(int side) const
+{
+    int positions = 0;
+    for (int v = 0; v < count(); v++) {
+        int d = degree(side, v);
+        if (d > 0) {
+            positions = qMax(positions, sortedNeighbors(side, v)[d - 1] + 1);
+        }
+    }
+    return positions;
+}
+
+// Accumulator tree over positions in the neighbour (Barth, Juenger,
+// Mutzel). Edges are visited by position here, then by position there;
+// every edge crosses the visited ones that end strictly below it.
+long long LayeredGraph::Layer::crossings(int side) const
+{
+    if (adjacency[side].isEmpty()) {
+        return 0;
+    }
+
+    int positions = positionCount(side);
+    int firstIndex = 1;
+    while (firstIndex < positions) {
+        firstIndex *= 2;
+    }
+    QVector<int> tree(2 * firstIndex - 1, 0);
+    firstIndex--;
+
+    long long result = 0;
+    for (int p = 0; p < count(); p++) {
+        int v = order[p];
+        auto neighbors = sortedNeighbors(side, v);
+        for (int k = 0; k < degree(side, v); k++) {
+            int index = neighbors[k] + firstIndex;
+            tree[index]++;
+            while (index > 0) {
+                if (index % 2) {
+                    result += tree[index + 1];
+                }
+                index = (index - 1) / 2;
+                tree[index]++;
+            }
+        }
+    }
+    return result;
+}
+
+// Edges of n ending below y minus those ending above
+void LayeredGraph::Layer::fillSwapTable(int side, int n,
+                                        QVector<int> &table) const
+{
+    auto x = sortedNeighbors(side, n);
+    int d = degree(side, n);
+    int below = 0, notAbove = 0;
+    for (int y = 0; y < table.size(); y++) {
+        while (below < d && x[below] < y) {
+            below++;
+        }
+        while (notAbove < d && x[notAbove] <= y) {
+            notAbove++;
+        }
+        table[y] = below - (d - notAbove);
+    }
+}
@@ -0,0 +1,72 @@
+#ifndef LAYEREDGRAPH_H
+#define LAYEREDGRAPH_H
+
+#include <QVector>
+#include <QList>
+
+#include "vnode.h"
+
+// Layers of the layout as flat arrays, rebuilt from the scene's VNodes
+// once per dataset. Node ids are local to a layer and edges only connect
+// adjacent layers, so ordering and coordinate passes touch contiguous
+// memory instead of refcounted nodes. VNodes stay the view for rendering.
+struct LayeredGraph
+{
+    struct Layer
+    {
+        int count() const { return order.size(); }
+        int degree(int side, int v) const
+        {
+            return offsets[side][v + 1] - offsets[side][v];
+        }
+        // Positions of the neighbours of v, ascending, see sortNeighbors()
+        const int *sortedNeighbors(int side, int v) const
+        {
+            return sorted[side].constData() + offsets[side][v];
+        }
+
+        // Number of positions in the neighbouring layer that edges reach
+        int positionCount(int side) const;
+        // Crossings of edges to one neighbouring layer, O(E log V)
+        long long crossings(int side) const;
+
+        // For every position y in the neighbouring layer, how many more
+        // crossings an edge ending at y has with the edges of n when n is
+        // after its node than when n is before it. Sized by the caller,
+        // at least positionCount(side).
+        void fillSwapTable(int side, int n, QVector<int> &table) const;
+        // Crossings with j before n minus crossings with n before j,
+        // given the table of n
+        int swapNodesDiff(int side, int j, const QVector<int> &table) const
+        {
+            auto y = sortedNeighbors(side, j);
+            int result = 0;
+            for (int k = 0, d = degree(side, j); k < d; k++) {
+                result += table[y[k]];
+            }
+            return result;
+        }
+
+        QVector<VNodeRef> nodes;
+        // Node id at each position and position of each node id
+        QVector<int> order, position;
+        QVector<bool> moveable;
+
+        // Edges to the previous (0) and the next (1) layer: neighbour ids
+        // of node v are adjacency[side][offsets[side][v]] up to
+        // adjacency[side][offsets[side][v + 1]]
+        QVector<int> offsets[2], adjacency[2];
+        QVector<int> sorted[2];
+
+        QVector<qreal> y, sizes, newY;
+    };
+
+    void build(const QList<QVector<VNodeRef> > &);
+    // Refreshes sorted positions of neighbours on one side of layer l
+    void sortNeighbors(int l, int side);
+    QVector<VNodeRef> nodesInOrder(int l) const;
+
+    QVector<Layer> layers;
+};
+
+#endif // LAYEREDGRAPH_H
@@ -12,8 +12,11 @@ Q_GLOBAL_STATIC(Loggers, loggers)
 
 static void messageHandler(QtMsgType type, const char *msg)
 {
+    // Messages may come from the worker thread
+    QString text(QString::fromLocal8Bit(msg));
     foreach (auto i, *loggers()) {
-        i->message(type, msg);
+        QMetaObject::invokeMethod(i, "addMessage", Qt::AutoConnection,
+                                  Q_ARG(int, type), Q_ARG(QString, text));
     }
 
     if (oldMsgHandler) {
@@ -50,6 +53,11 @@ LogWidget::~LogWidget()
 }
 
 void LogWidget::message(QtMsgType type, const char *msg)
+{
+    addMessage(type, QString::fromLocal8Bit(msg));
+}
+
+void LogWidget::addMessage(int type, const QString &msg)
 {
     QIcon *icon;
 
@@ -64,8 +72,7 @@ void LogWidget::message(QtMsgType type, const char *msg)
         icon = &criticalIcon;
     }
 
-    QScopedPointer<QStandardItem> item(new QStandardItem(
-                                           *icon, QString::fromLocal8Bit(msg)));
+    QScopedPointer<QStandardItem> item(new QStandardItem(*icon, msg));
     model->appendRow(item.data());
     item.take();
 
@@ -19,7 +19,10 @@ signals:
 public slots:
     void message(QtMsgType, const char *);
     void clear();
-    
+
+private slots:
+    void addMessage(int type, const QString &);
+
 private:
     QIcon debugIcon, warningIcon, criticalIcon;
     QListView *view;
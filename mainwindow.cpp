@@ -1,5 +1,7 @@
 #include "mainwindow.h"
 
+#include <algorithm>
+
 #include <QToolBar>
 #include <QDockWidget>
 #include <QAction>
@@ -10,10 +12,12 @@
 #include <QSvgGenerator>
 #include <QImageWriter>
 #include <QMessageBox>
+#include <QFile>
 
 #include "dockbutton.h"
 #include "persistentwidget.h"
 #include "dataset.h"
+#include "publicationdiskcache.h"
 #include "visualisationsettingswidget.h"
 
 static void generateViewMenu(const QObject *widget, QMenu *menu)
@@ -75,6 +79,13 @@ MainWindow::MainWindow(QSettings *settings, QWidget *parent)
     queryAction->setShortcut(QKeySequence::Refresh);
     connect(queryAction, SIGNAL(triggered()), SLOT(executeQuery()));
 
+    refreshAction = toolBar->addAction("Refresh");
+    refreshAction->setIcon(QIcon::fromTheme("view-refresh"));
+    refreshAction->setToolTip("Run the query again, fetching only new and "
+                              "changed publications");
+    refreshAction->setEnabled(false);
+    connect(refreshAction, SIGNAL(triggered()), SLOT(refreshQuery()));
+
     stopAction = toolBar->addAction("Stop");
     stopAction->setIcon(QIcon::fromTheme("process-stop"));
     stopAction->setShortcut(QKeySequence::Quit);
@@ -86,6 +97,16 @@ MainWindow::MainWindow(QSettings *settings, QWidget *parent)
     clearAction->setEnabled(false);
     connect(clearAction, SIGNAL(triggered()), SLOT(clear()));
 
+    auto openSnapshotAction = toolBar->addAction("Open snapshot");
+    openSnapshotAction->setIcon(QIcon::fromTheme("document-open"));
+    openSnapshotAction->setShortcut(QKeySequence::Open);
+    connect(openSnapshotAction, SIGNAL(triggered()), SLOT(openSnapshot()));
+
+    saveSnapshotAction = toolBar->addAction("Save snapshot");
+    saveSnapshotAction->setIcon(QIcon::fromTheme("document-save"));
+    saveSnapshotAction->setEnabled(false);
+    connect(saveSnapshotAction, SIGNAL(triggered()), SLOT(saveSnapshot()));
+
     auto exportAction = toolBar->addAction("Export");
     exportAction->setIcon(QIcon::fromTheme("document-save-as"));
     exportAction->setShortcut(QKeySequence::Save);
@@ -109,6 +130,12 @@ MainWindow::MainWindow(QSettings *settings, QWidget *parent)
     logDock->hide();
     connect(log, SIGNAL(message()), logDock, SLOT(show()));
 
+    statisticsWidget = new StatisticsWidget(this);
+    auto statisticsDock = addDockWidget(statisticsWidget, "Statistics",
+                                        "Query statistics");
+    tabifyDockWidget(logDock, statisticsDock);
+    statisticsDock->hide();
+
     nodeWidget = new NodeInfoWidget(this);
     nodeDock = addDockWidget(nodeWidget, "NodeInfo", "Node Info",
                              Qt::LeftDockWidgetArea);
@@ -275,21 +302,43 @@ void MainWindow::addToDockBar(Qt::DockWidgetArea area, QDockWidget *dockwidget)
 }
 
 void MainWindow::executeQuery()
+{
+    runQuery(false);
+}
+
+void MainWindow::refreshQuery()
+{
+    runQuery(true);
+}
+
+void MainWindow::runQuery(bool refresh)
 {
     log->clear();
+    statisticsWidget->clear();
 
     stopAction->setEnabled(false);
-    delete dataset;
+    saveSnapshotAction->setEnabled(false);
+    refreshAction->setEnabled(false);
+
+    auto diskCache = PublicationDiskCache::instance();
+    diskCache->setMaxAge(settingsWidget->cacheDays() * 24 * 60 * 60);
+    diskCache->setMaxSize(settingsWidget->cacheSizeMb() * 1024LL * 1024);
+    Dataset::setCacheBudget(settingsWidget->memoryCacheMb() * 1024 * 1024);
+
+    auto previous = dataset;
     dataset = new Dataset(settingsWidget->endpointUrl(),
                           query->text(),
                           settingsWidget->datePredicate(),
                           settingsWidget->titlePredicate(),
                           settingsWidget->referencePredicate(),
                           settingsWidget->dateRegEx(),
-                          settingsWidget->loadReferences(), this);
+                          settingsWidget->loadReferences(),
+                          settingsWidget->useValuesQuery(),
+                          refresh ? previous : 0, this);
+    delete previous;
 
-    connect(dataset, SIGNAL(progress(int,int)), view->progressOverlay(),
-            SLOT(setProgress(int,int)));
+    connect(dataset, SIGNAL(progress(Dataset::Progress)),
+            SLOT(showProgress(Dataset::Progress)));
     connect(dataset, SIGNAL(finished()), view->progressOverlay(), SLOT(done()));
 
     dataset->connect(stopAction, SIGNAL(triggered()), SLOT(abort()));
@@ -297,13 +346,29 @@ void MainWindow::executeQuery()
     stopAction->setEnabled(true);
 
     view->progressOverlay()->setProgress(0, 0);
+    view->progressOverlay()->setDetails(QString());
+}
+
+void MainWindow::showProgress(const Dataset::Progress &p)
+{
+    auto overlay = view->progressOverlay();
+    overlay->setProgress(p.done, p.total);
+    overlay->setDetails(tr("%1 queries running, %2 queued, %3 KiB")
+                        .arg(p.queriesInFlight).arg(p.queued)
+                        .arg(p.bytesReceived / 1024));
 }
 
 void MainWindow::showGraph()
 {
     clearAction->setEnabled(true);
     stopAction->setDisabled(true);
+    saveSnapshotAction->setEnabled(!dataset->hasError());
+    refreshAction->setEnabled(!dataset->hasError());
+    statisticsWidget->setStatistics(dataset->statistics());
+
     scene->randomize = settingsWidget->randomize();
+    scene->layoutRuns = settingsWidget->layoutRuns();
+    scene->seed = settingsWidget->layoutSeed();
     scene->setDataset(*dataset,
                       settingsWidget->useBarycenterHeuristic(),
                       settingsWidget->useSlowAlgorithm());
@@ -318,8 +383,28 @@ void MainWindow::showGraph()
                              QString::number(scene->improvementSteps()),
                              QString::number(scene->totalSeconds())));
 
-    nodeWidget->setEndpoint(settingsWidget->endpointUrl(),
-                            dataset->queryParameters());
+    auto &runs = scene->layoutRunIntersections();
+    if (runs.size() > 1) {
+        static const QString runsText(" Runs: %1 Intersections: %2-%3");
+        statusLabel->setText(statusLabel->text() + runsText.arg(
+                                 QString::number(runs.size()),
+                                 QString::number(*std::min_element(
+                                                     runs.begin(), runs.end())),
+                                 QString::number(*std::max_element(
+                                                     runs.begin(), runs.end()))));
+    }
+
+    // Nodes are drawn either way, without this the graph looks complete
+    int failed = dataset->failedPublications().size();
+    if (failed > 0) {
+        static const QString failedText(" Missing properties: %1");
+        statusLabel->setText(statusLabel->text() +
+                             failedText.arg(QString::number(failed)));
+        qWarning() << "Properties of" << failed << "publications couldn't be"
+                   << "loaded, their nodes are outlined";
+    }
+
+    nodeWidget->setDataset(*dataset);
 }
 
 void MainWindow::selectedNodeChanged()
@@ -335,6 +420,62 @@ void MainWindow::clear()
     scene->setDataset(*dataset);
     clearAction->setEnabled(false);
     stopAction->setDisabled(true);
+    saveSnapshotAction->setEnabled(false);
+    refreshAction->setEnabled(false);
+}
+
+static const QString snapshotFilter("Dataset snapshots (*.cnvd)");
+
+void MainWindow::saveSnapshot()
+{
+    auto fileName = QFileDialog::getSaveFileName(this, "Save snapshot",
+                                                 QString(), snapshotFilter);
+    if (fileName.isEmpty()) {
+        return;
+    }
+
+    QFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate) ||
+            !dataset->saveSnapshot(&file))
+    {
+        QMessageBox::critical(this, "Save snapshot",
+                              "Can't write " + fileName + ": " +
+                              file.errorString());
+    }
+}
+
+void MainWindow::openSnapshot()
+{
+    auto fileName = QFileDialog::getOpenFileName(this, "Open snapshot",
+                                                 QString(), snapshotFilter);
+    if (fileName.isEmpty()) {
+        return;
+    }
+
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly)) {
+        QMessageBox::critical(this, "Open snapshot",
+                              "Can't open " + fileName + ": " +
+                              file.errorString());
+        return;
+    }
+
+    // The current graph stays if the snapshot is unreadable
+    auto loaded = new Dataset(this);
+    if (!loaded->loadSnapshot(&file)) {
+        QMessageBox::critical(this, "Open snapshot",
+                              "Can't read " + fileName + ": " +
+                              loaded->errorString());
+        delete loaded;
+        return;
+    }
+
+    log->clear();
+    statisticsWidget->clear();
+
+    delete dataset;
+    dataset = loaded;
+    showGraph();
 }
 
 void MainWindow::exportImage()
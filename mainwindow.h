@@ -14,6 +14,7 @@
 #include "scene.h"
 #include "graphview.h"
 #include "nodeinfowidget.h"
+#include "statisticswidget.h"
 
 class MainWindow : public QMainWindow
 {
@@ -31,10 +32,14 @@ private slots:
     void dockWidgetTopLevelChanged(bool);
 
     void executeQuery();
+    void refreshQuery();
     void clear();
     void exportImage();
+    void saveSnapshot();
+    void openSnapshot();
 
     void showGraph();
+    void showProgress(const Dataset::Progress &);
     void selectedNodeChanged();
 
 private:
@@ -47,12 +52,14 @@ private:
     void removeButton(QDockWidget *);
     QToolBar *addDockBar(Qt::ToolBarArea area);
     QScrollArea *makeScrollable(QWidget *widget);
+    void runQuery(bool refresh);
 
     GraphView *view;
     QMap<Qt::DockWidgetArea, QToolBar *> dockBars;
     QMap<QDockWidget *, QAction *> dockButtons;
 
     LogWidget *log;
+    StatisticsWidget *statisticsWidget;
     QueryEditor *query;
     DataSettingsWidget *settingsWidget;
     NodeInfoWidget *nodeWidget;
@@ -62,6 +69,8 @@ private:
     Dataset *dataset;
     QAction *stopAction;
     QAction *clearAction;
+    QAction *refreshAction;
+    QAction *saveSnapshotAction;
     Scene *scene;
     QFileDialog *exportDialog;
     QLabel *statusLabel;
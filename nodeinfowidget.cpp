@@ -9,8 +9,13 @@
 #include <QClipboard>
 #include <QApplication>
 
+// Property tables, counted in values
+static const int cacheSize = 64 * 1024;
+static const int maxPrefetch = 8;
+
 NodeInfoWidget::NodeInfoWidget(QWidget *parent) :
-    QWidget(parent), info(QStringRef())
+    QWidget(parent), cache(cacheSize), showingPublication(false),
+    info(QStringRef())
 {
     auto layout = new QGridLayout(this);
 
@@ -41,49 +46,217 @@ NodeInfoWidget::NodeInfoWidget(QWidget *parent) :
             SLOT(itemDoubleClicked(QModelIndex)));
 }
 
-void NodeInfoWidget::setEndpoint(const QUrl &url, const SparqlQueryInfo &info)
+static QString stripBrackets(const QString &iri)
 {
-    endpoint = url;
-    this->info = info;
+    if (iri.startsWith('<') && iri.endsWith('>')) {
+        return iri.mid(1, iri.size() - 2);
+    }
+    return iri;
 }
 
-void NodeInfoWidget::setNode(const QString &subject)
+void NodeInfoWidget::setDataset(const Dataset &ds)
 {
-    if (subject.isEmpty()) {
-        return;
+    // Property tables depend on the FROM clauses too. Answers of queries
+    // still running are for the old graphs and are dropped.
+    if (ds.endpointUrl() != endpoint ||
+            ds.queryParameters().dataset() != info.dataset())
+    {
+        cache.clear();
+        querySubjects.clear();
+        received.clear();
+        prefetchQueue.clear();
+        prefetch.clear();
+        query.clear();
+    }
+    endpoint = ds.endpointUrl();
+    info = ds.queryParameters();
+
+    publications = ds.publications();
+    citedBy.clear();
+    for (auto i = publications.constBegin(); i != publications.constEnd(); i++) {
+        foreach (auto ref, i->references) {
+            citedBy[ref].append(i.key());
+        }
     }
 
+    datePredicate = stripBrackets(ds.datePredicate());
+    titlePredicate = stripBrackets(ds.titlePredicate());
+    referencePredicate = stripBrackets(ds.referencePredicate());
+}
+
+QSharedPointer<SparqlQuery> NodeInfoWidget::createQuery(const QString &subject)
+{
     QString q;
     q.append("SELECT ?p ?o ");
     q.append(info.dataset());
     q.append(" WHERE { <");
     q.append(subject);
     q.append("> ?p ?o. }");
-    query = QSharedPointer<SparqlQuery>(new SparqlQuery(endpoint, q));
-
-    model->removeRows(0, model->rowCount());
 
-    connect(query.data(), SIGNAL(results(SparqlQuery::Results)),
+    // Deleted later, queries are released from their own signals
+    QSharedPointer<SparqlQuery> sq(new SparqlQuery(endpoint, q),
+                                   &QObject::deleteLater);
+    connect(sq.data(), SIGNAL(results(SparqlQuery::Results)),
             SLOT(dataArrived(SparqlQuery::Results)));
-    query->exec();
+    connect(sq.data(), SIGNAL(finished()), SLOT(queryFinished()));
+    querySubjects.insert(sq.data(), subject);
+    sq->exec();
+    return sq;
+}
+
+void NodeInfoWidget::setNode(const QString &subject)
+{
+    if (subject.isEmpty()) {
+        return;
+    }
+
+    currentSubject = subject;
+    model->removeRows(0, model->rowCount());
+    showingPublication = false;
 
     static const QString linkFormat("<a href=\"%1\">%1</a>");
     title->setText(linkFormat.arg(subject));
+
+    // An unfinished query goes on in the background if there is room
+    if (query && !query->isFinished()) {
+        if (!prefetch) {
+            prefetch = query;
+        } else {
+            querySubjects.remove(query.data());
+            received.remove(query.data());
+        }
+    }
+    query.clear();
+
+    if (auto cached = cache.object(subject)) {
+        showResults(*cached);
+    } else if (prefetch && querySubjects.value(prefetch.data()) == subject) {
+        // Already on the way
+        query = prefetch;
+        prefetch.clear();
+        showResults(received.value(query.data()));
+    } else {
+        Identifier id(subject);
+        auto found = publications.constFind(id);
+        if (found != publications.constEnd()) {
+            showPublication(*found);
+        }
+        query = createQuery(subject);
+    }
+
+    prefetchQueue.clear();
+    Identifier id(subject);
+    auto found = publications.constFind(id);
+    QList<Identifier> neighbours = citedBy.value(id);
+    if (found != publications.constEnd()) {
+        neighbours += found->references.toList();
+    }
+    foreach (auto i, neighbours) {
+        if (prefetchQueue.size() >= maxPrefetch) {
+            break;
+        }
+        if (!cache.contains(i.toString()) &&
+                !prefetchQueue.contains(i.toString()))
+        {
+            prefetchQueue.append(i.toString());
+        }
+    }
+    startPrefetch();
+}
+
+void NodeInfoWidget::startPrefetch()
+{
+    if (prefetch || (query && !query->isFinished())) {
+        return;
+    }
+
+    while (!prefetchQueue.isEmpty()) {
+        auto subject = prefetchQueue.takeFirst();
+        if (!cache.contains(subject)) {
+            prefetch = createQuery(subject);
+            return;
+        }
+    }
 }
 
 void NodeInfoWidget::dataArrived(const SparqlQuery::Results &results)
+{
+    auto q = qobject_cast<SparqlQuery*>(sender());
+    if (!querySubjects.contains(q)) {
+        return;
+    }
+
+    auto &all = received[q];
+    all.variables = results.variables;
+    all.values += results.values;
+
+    if (q == query.data()) {
+        if (showingPublication) {
+            model->removeRows(0, model->rowCount());
+            showingPublication = false;
+        }
+        showResults(results);
+    }
+}
+
+void NodeInfoWidget::queryFinished()
+{
+    auto q = qobject_cast<SparqlQuery*>(sender());
+    if (querySubjects.contains(q) && !q->hasError()) {
+        auto results = new SparqlQuery::Results(received.value(q));
+        cache.insert(querySubjects.value(q), results,
+                     qMax(1, results->values.size()));
+    }
+    querySubjects.remove(q);
+    received.remove(q);
+
+    if (q == prefetch.data()) {
+        prefetch.clear();
+    }
+    startPrefetch();
+}
+
+void NodeInfoWidget::showResults(const SparqlQuery::Results &results)
 {
     static const QString pVar("p");
     static const QString oVar("o");
-    for (auto i : results) {
-        QScopedPointer<QStandardItem> p(
-                    new QStandardItem(info.shorten(i[pVar])));
-        QScopedPointer<QStandardItem> o(
-                    new QStandardItem(info.shorten(i[oVar])));
-        model->appendRow(QList<QStandardItem*>() << p.data() << o.data());
-        p.take();
-        o.take();
+    int p = results.column(pVar), o = results.column(oVar);
+    if (p < 0 || o < 0) {
+        return;
     }
+
+    for (int row = 0; row < results.rowCount(); row++) {
+        addRow(results.at(row, p), results.at(row, o));
+    }
+}
+
+// Only what the dataset keeps: title, date substrings and references
+void NodeInfoWidget::showPublication(const Publication &p)
+{
+    if (!titlePredicate.isEmpty() && !p.title.isEmpty()) {
+        addRow(titlePredicate, p.title);
+    }
+    if (!datePredicate.isEmpty()) {
+        foreach (auto i, p.dates) {
+            addRow(datePredicate, i);
+        }
+    }
+    foreach (auto i, p.references) {
+        addRow(referencePredicate, i.toString());
+    }
+    showingPublication = true;
+}
+
+void NodeInfoWidget::addRow(const QString &predicate, const QString &object)
+{
+    QScopedPointer<QStandardItem> pItem(
+                new QStandardItem(info.shorten(predicate)));
+    QScopedPointer<QStandardItem> oItem(
+                new QStandardItem(info.shorten(object)));
+    model->appendRow(QList<QStandardItem*>() << pItem.data()
+                     << oItem.data());
+    pItem.take();
+    oItem.take();
 }
 
 void NodeInfoWidget::selectionChanged()
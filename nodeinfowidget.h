@@ -7,9 +7,12 @@
 #include <QStandardItemModel>
 #include <QLabel>
 #include <QTableView>
+#include <QCache>
+#include <QHash>
 
 #include "sparqlquery.h"
 #include "sparqlqueryinfo.h"
+#include "dataset.h"
 
 class NodeInfoWidget : public QWidget
 {
@@ -17,19 +20,43 @@ class NodeInfoWidget : public QWidget
 public:
     explicit NodeInfoWidget(QWidget *parent = 0);
 
-    void setEndpoint(const QUrl &, const SparqlQueryInfo &);
+    // Endpoint, prefixes and already loaded publications
+    void setDataset(const Dataset &);
 
 public slots:
     void setNode(const QString &subject);
 
 private slots:
     void dataArrived(const SparqlQuery::Results &);
+    void queryFinished();
     void selectionChanged();
     void copyTriggered();
     void itemDoubleClicked(QModelIndex);
 
 private:
+    QSharedPointer<SparqlQuery> createQuery(const QString &subject);
+    void startPrefetch();
+    void showResults(const SparqlQuery::Results &);
+    void showPublication(const Publication &);
+    void addRow(const QString &predicate, const QString &object);
+
+    // Foreground query for the selected node, and one background query
+    // for a neighbour at a time while the foreground one is idle
     QSharedPointer<SparqlQuery> query;
+    QSharedPointer<SparqlQuery> prefetch;
+    QHash<SparqlQuery*, QString> querySubjects;
+    QHash<SparqlQuery*, SparqlQuery::Results> received;
+    QStringList prefetchQueue;
+    QCache<QString, SparqlQuery::Results> cache;
+
+    QString currentSubject;
+    // Rows come from the dataset until the query answers
+    bool showingPublication;
+
+    QHash<Identifier, Publication> publications;
+    QHash<Identifier, QList<Identifier> > citedBy;
+    QString datePredicate, titlePredicate, referencePredicate;
+
     QStandardItemModel *model;
     QTableView *table;
     QLabel *title;
@@ -33,6 +33,15 @@ void ProgressOverlay::setProgress(int value, int total)
     bar->setMaximum(total);
 }
 
+void ProgressOverlay::setDetails(const QString &details)
+{
+    if (details.isEmpty()) {
+        bar->setFormat("%p%");
+    } else {
+        bar->setFormat("%v / %m, " + details);
+    }
+}
+
 void ProgressOverlay::done()
 {
     animate(QAbstractAnimation::Backward);
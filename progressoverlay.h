@@ -14,6 +14,8 @@ public:
 
 public slots:
     void setProgress(int value, int total);
+    // Shown after the value in the bar
+    void setDetails(const QString &);
     void done();
 
 protected:
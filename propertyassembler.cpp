@@ -0,0 +1,120 @@
+#include "propertyassembler.h"
+
+#include <QCryptographicHash>
+#include <QDebug>
+
+// Summand of Publication::digest for one row
+static quint64 rowDigest(const QString &predicate, const QString &object)
+{
+    auto md5 = QCryptographicHash::hash((predicate + ' ' + object).toUtf8(),
+                                        QCryptographicHash::Md5);
+    quint64 d = 0;
+    for (int i = 0; i < 8; i++) {
+        d = (d << 8) | static_cast<uchar>(md5[i]);
+    }
+    return d;
+}
+
+PropertyAssembler::PropertyAssembler(const QString &hasDateResolved,
+                                     const QString &hasTitleResolved,
+                                     const QString &referenceResolved,
+                                     const QRegExp &dateSubstring)
+    : dates(dateSubstring.pattern())
+{
+    qRegisterMetaType<QList<Publication> >("QList<Publication>");
+
+    addPredicate(referenceResolved, Reference);
+    addPredicate(hasTitleResolved, Title);
+    addPredicate(hasDateResolved, Date);
+}
+
+// Resolved predicates are <iri>, the results carry the bare IRI
+void PropertyAssembler::addPredicate(const QString &resolved, Property kind)
+{
+    if (resolved.size() > 2 && resolved.startsWith('<') &&
+            resolved.endsWith('>'))
+    {
+        predicates.insert(resolved.mid(1, resolved.size() - 2), kind);
+    }
+}
+
+void PropertyAssembler::addProperties(const SparqlQuery::Results &results)
+{
+    static const QString subject("s"), predicate("p"), object("o");
+    static const QString unexpectedData("Unexpected data. "
+                                        "Wrong generated query or "
+                                        "endpoint problems");
+
+    int s = results.column(subject), p = results.column(predicate),
+            o = results.column(object);
+    if (results.columnCount() != 3 || s < 0 || p < 0 || o < 0) {
+        emit assembled(QList<Publication>(), 0, unexpectedData);
+        return;
+    }
+
+    QList<Publication> batch;
+    QHash<Identifier, int> batchIndex;
+    qint64 missesBefore = dates.misses();
+    QString date;
+
+    // Rows of a subject usually come together, so subjects are interned
+    // when they change. References are interned in one go at the end.
+    QString lastSubject;
+    int current = -1;
+    QVector<QString> references;
+    QVector<int> referencedBy;
+
+    for (int row = 0; row < results.rowCount(); row++) {
+        auto &subjectValue = results.at(row, s);
+        auto &predicateValue = results.at(row, p);
+        auto &objectValue = results.at(row, o);
+        if (subjectValue.isNull() || predicateValue.isNull() ||
+                objectValue.isNull())
+        {
+            emit assembled(QList<Publication>(), 0, unexpectedData);
+            return;
+        }
+
+        if (current < 0 || subjectValue != lastSubject) {
+            Identifier id(subjectValue);
+            auto found = batchIndex.constFind(id);
+            if (found == batchIndex.constEnd()) {
+                found = batchIndex.insert(id, batch.size());
+                batch.append(Publication(id));
+            }
+            current = *found;
+            lastSubject = subjectValue;
+        }
+        auto &j = batch[current];
+
+        auto kind = predicates.constFind(predicateValue);
+        if (kind == predicates.constEnd()) {
+            emit assembled(QList<Publication>(), 0,
+                           "Unexpected predicate <" + predicateValue +
+                           ">. Wrong generated query or endpoint problems");
+            return;
+        }
+        j.digest += rowDigest(predicateValue, objectValue);
+
+        switch (*kind) {
+        case Date:
+            dates.extract(objectValue, date);
+            j.dates.insert(date);
+            break;
+        case Title:
+            j.title = objectValue;
+            break;
+        case Reference:
+            references.append(objectValue);
+            referencedBy.append(current);
+            break;
+        }
+    }
+
+    auto referenceIds = Identifier::fromStrings(references);
+    for (int k = 0; k < referenceIds.size(); k++) {
+        batch[referencedBy[k]].references.insert(referenceIds[k]);
+    }
+
+    emit assembled(batch, int(dates.misses() - missesBefore), QString());
+}
@@ -0,0 +1,49 @@
+#ifndef PROPERTYASSEMBLER_H
+#define PROPERTYASSEMBLER_H
+
+#include <QObject>
+#include <QRegExp>
+#include <QMetaType>
+#include <QHash>
+
+#include "sparqlquery.h"
+#include "publication.h"
+#include "dateextractor.h"
+
+Q_DECLARE_METATYPE(QList<Publication>)
+
+// Turns property query rows into partial publications on the worker
+// thread. Dataset merges them on the GUI thread. Date literals without a
+// date substring are counted per batch instead of logged.
+class PropertyAssembler : public QObject
+{
+    Q_OBJECT
+public:
+    PropertyAssembler(const QString &hasDateResolved,
+                      const QString &hasTitleResolved,
+                      const QString &referenceResolved,
+                      const QRegExp &dateSubstring);
+
+public slots:
+    void addProperties(const SparqlQuery::Results &);
+
+signals:
+    void assembled(const QList<Publication> &, int dateMisses,
+                   const QString &error);
+
+private:
+    enum Property
+    {
+        Date,
+        Title,
+        Reference
+    };
+
+    void addPredicate(const QString &resolved, Property);
+
+    // Bare predicate IRIs as they appear in ?p, resolved once
+    QHash<QString, Property> predicates;
+    DateExtractor dates;
+};
+
+#endif // PROPERTYASSEMBLER_H
@@ -9,7 +9,7 @@ class Publication
 {
 public:
     explicit Publication(const Identifier &iri, bool fromMainQuery = false)
-        : recurse(fromMainQuery), id(iri)
+        : recurse(fromMainQuery), digest(0), id(iri)
     {
     }
 
@@ -19,6 +19,9 @@ public:
     QSet<QString> dates;
     QSet<Identifier> references;
     bool recurse;
+    // Wrapping sum over the property rows of the first 64 bits of
+    // MD5("p o"), independent of row order. See Dataset::runRevalidation()
+    quint64 digest;
 
     const QString &nonEmptyTitle() const {
         return title.isEmpty() ? id.toString() : title;
@@ -0,0 +1,364 @@
+#include "publicationdiskcache.h"
+
+#include <QDataStream>
+#include <QDateTime>
+#include <QFileInfo>
+#include <QMap>
+#include <QDebug>
+#if QT_VERSION >= QT_VERSION_CHECK(5,0,0)
+#   include <QStandardPaths>
+#else
+#   include <QDesktopServices>
+#endif
+
+Q_GLOBAL_STATIC(PublicationDiskCache, diskCache)
+
+static const quint32 fileMagic = 0x434e5643; // "CNVC"
+static const quint32 indexMagic = 0x434e5649; // "CNVI"
+static const quint32 fileVersion = 3;
+static const qint64 headerSize = 2 * sizeof(quint32);
+// IRI hash, offset, time stored and record size
+static const qint64 indexEntrySize = 3 * sizeof(qint64) + sizeof(quint32);
+static const QDataStream::Version streamVersion = QDataStream::Qt_4_6;
+
+static const qint64 msecsPerSec = 1000;
+
+// 64-bit FNV-1a of the UTF-8 IRI. Records keep the IRI, so a collision
+// is a miss, not a wrong publication.
+static quint64 iriHash(const QByteArray &iri)
+{
+    quint64 hash = Q_UINT64_C(14695981039346656037);
+    for (int i = 0; i < iri.size(); i++) {
+        hash ^= static_cast<uchar>(iri[i]);
+        hash *= Q_UINT64_C(1099511628211);
+    }
+    return hash;
+}
+
+static QString indexPath(const QFileInfo &dataFile)
+{
+    return dataFile.dir().filePath(dataFile.completeBaseName() + ".index");
+}
+
+static void replaceWith(QFile &file, QFile &tmp)
+{
+    QString name = file.fileName();
+    file.close();
+    QFile::remove(name);
+    tmp.rename(name);
+    file.open(QIODevice::ReadWrite);
+}
+
+PublicationDiskCache *PublicationDiskCache::instance()
+{
+    return diskCache();
+}
+
+PublicationDiskCache::PublicationDiskCache()
+    : maxAge(7 * 24 * 60 * 60), maxSize(64 * 1024 * 1024)
+{
+#if QT_VERSION >= QT_VERSION_CHECK(5,0,0)
+    QString location =
+            QStandardPaths::writableLocation(QStandardPaths::CacheLocation);
+#else
+    QString location =
+            QDesktopServices::storageLocation(QDesktopServices::CacheLocation);
+#endif
+    dir.setPath(location);
+    dir.mkpath("publications");
+    dir.cd("publications");
+}
+
+QString PublicationDiskCache::fileName(const QByteArray &context) const
+{
+    return dir.filePath(QString::fromLatin1(context.toHex()) + ".cache");
+}
+
+QString PublicationDiskCache::indexFileName(const QByteArray &context) const
+{
+    return dir.filePath(QString::fromLatin1(context.toHex()) + ".index");
+}
+
+bool PublicationDiskCache::expired(const Entry &e) const
+{
+    return QDateTime::currentMSecsSinceEpoch() - e.stored
+            > maxAge * msecsPerSec;
+}
+
+PublicationDiskCache::Index &
+PublicationDiskCache::index(const QByteArray &context)
+{
+    auto found = indices.find(context);
+    if (found != indices.end()) {
+        return *found;
+    }
+
+    Index &idx = indices[context];
+    idx.file = QSharedPointer<QFile>(new QFile(fileName(context)));
+    idx.indexFile = QSharedPointer<QFile>(new QFile(indexFileName(context)));
+    if (!idx.file->open(QIODevice::ReadWrite) ||
+            !idx.indexFile->open(QIODevice::ReadWrite))
+    {
+        qWarning() << "Can't open cache file" << idx.file->fileName();
+        idx.file.clear();
+        idx.indexFile.clear();
+        return idx;
+    }
+
+    QDataStream in(idx.file.data());
+    in.setVersion(streamVersion);
+
+    quint32 magic = 0, version = 0;
+    in >> magic >> version;
+    if (magic != fileMagic || version != fileVersion) {
+        return idx;
+    }
+
+    // The whole index in one read, records stay on disk
+    auto bytes = idx.indexFile->readAll();
+    QDataStream entries(bytes);
+    entries.setVersion(streamVersion);
+
+    magic = version = 0;
+    entries >> magic >> version;
+    if (magic != indexMagic || version != fileVersion) {
+        return idx;
+    }
+
+    qint64 dataSize = idx.file->size();
+    idx.end = idx.indexEnd = headerSize;
+    idx.entries.reserve((bytes.size() - headerSize) / indexEntrySize);
+    while (!entries.atEnd()) {
+        quint64 hash;
+        Entry e;
+        entries >> hash >> e.offset >> e.stored >> e.size;
+        // Left by a write that didn't finish, the rest is overwritten
+        if (entries.status() != QDataStream::Ok || e.offset < headerSize ||
+                e.offset + qint64(sizeof(e.size)) + e.size > dataSize)
+        {
+            qWarning() << "Truncated cache index" << idx.indexFile->fileName();
+            break;
+        }
+
+        auto old = idx.entries.find(hash);
+        if (old != idx.entries.end()) {
+            idx.dead += sizeof(old->size) + old->size;
+        }
+        idx.entries.insert(hash, e);
+
+        idx.end = qMax(idx.end, e.offset + qint64(sizeof(e.size)) + e.size);
+        idx.indexEnd += indexEntrySize;
+    }
+
+    qDebug() << "Disk cache" << idx.file->fileName() << "has"
+             << idx.entries.size() << "publications";
+    return idx;
+}
+
+bool PublicationDiskCache::read(Index &idx, qint64 offset,
+                                const Identifier &id, Publication &pub)
+{
+    idx.file->seek(offset);
+    QDataStream in(idx.file.data());
+    in.setVersion(streamVersion);
+
+    quint32 size;
+    qint64 stored;
+    QByteArray iri, title;
+    QList<QByteArray> dates, references;
+    in >> size >> stored >> iri >> title >> dates >> references
+       >> pub.digest;
+    if (in.status() != QDataStream::Ok || iri != id.toString().toUtf8()) {
+        return false;
+    }
+
+    pub.title = QString::fromUtf8(title);
+    pub.dates.clear();
+    foreach (auto i, dates) {
+        pub.dates.insert(QString::fromUtf8(i));
+    }
+
+    QVector<QString> referenceIris;
+    referenceIris.reserve(references.size());
+    foreach (auto i, references) {
+        referenceIris.append(QString::fromUtf8(i));
+    }
+    pub.references.clear();
+    foreach (auto i, Identifier::fromStrings(referenceIris)) {
+        pub.references.insert(i);
+    }
+    return true;
+}
+
+QHash<Identifier, Publication>
+PublicationDiskCache::find(const QByteArray &context,
+                           const QVector<Identifier> &ids)
+{
+    QHash<Identifier, Publication> hits;
+    if (ids.isEmpty()) {
+        return hits;
+    }
+
+    auto &idx = index(context);
+    if (!idx.file) {
+        return hits;
+    }
+
+    // Offsets of the hits in ascending order, reads go forward
+    QMap<qint64, int> found;
+    for (int i = 0; i < ids.size(); i++) {
+        auto entry = idx.entries.constFind(
+                    iriHash(ids[i].toString().toUtf8()));
+        if (entry != idx.entries.constEnd() && !expired(*entry)) {
+            found.insert(entry->offset, i);
+        }
+    }
+
+    for (auto i = found.constBegin(); i != found.constEnd(); ++i) {
+        Publication pub(ids[i.value()]);
+        if (read(idx, i.key(), ids[i.value()], pub)) {
+            hits.insert(pub.iri(), pub);
+        }
+    }
+    return hits;
+}
+
+void PublicationDiskCache::insert(const QByteArray &context,
+                                  const QList<Publication> &publications)
+{
+    auto &idx = index(context);
+    if (!idx.file || publications.isEmpty()) {
+        return;
+    }
+
+    QDataStream out(idx.file.data());
+    out.setVersion(streamVersion);
+    QDataStream indexOut(idx.indexFile.data());
+    indexOut.setVersion(streamVersion);
+
+    if (idx.end == 0) {
+        idx.file->resize(0);
+        idx.file->seek(0);
+        out << fileMagic << fileVersion;
+        idx.indexFile->resize(0);
+        idx.indexFile->seek(0);
+        indexOut << indexMagic << fileVersion;
+        idx.end = idx.indexEnd = headerSize;
+    } else {
+        idx.file->resize(idx.end);
+        idx.file->seek(idx.end);
+        idx.indexFile->resize(idx.indexEnd);
+        idx.indexFile->seek(idx.indexEnd);
+    }
+
+    qint64 now = QDateTime::currentMSecsSinceEpoch();
+    foreach (auto p, publications) {
+        QList<QByteArray> dates, references;
+        foreach (auto i, p.dates) {
+            dates.append(i.toUtf8());
+        }
+        foreach (auto i, p.references) {
+            references.append(i.toString().toUtf8());
+        }
+
+        auto iri = p.iri().toString().toUtf8();
+        QByteArray record;
+        QDataStream s(&record, QIODevice::WriteOnly);
+        s.setVersion(streamVersion);
+        s << now << iri << p.title.toUtf8() << dates << references
+          << p.digest;
+
+        Entry e;
+        e.offset = idx.end;
+        e.stored = now;
+        e.size = record.size();
+        out << e.size;
+        out.writeRawData(record.constData(), record.size());
+
+        quint64 hash = iriHash(iri);
+        indexOut << hash << e.offset << e.stored << e.size;
+
+        auto old = idx.entries.find(hash);
+        if (old != idx.entries.end()) {
+            idx.dead += sizeof(old->size) + old->size;
+        }
+        idx.entries.insert(hash, e);
+        idx.end += sizeof(e.size) + e.size;
+        idx.indexEnd += indexEntrySize;
+    }
+    idx.file->flush();
+    idx.indexFile->flush();
+
+    if (idx.dead > idx.end / 2) {
+        compact(idx);
+    }
+    enforceSizeLimit(context);
+}
+
+void PublicationDiskCache::compact(Index &idx)
+{
+    QFile tmp(idx.file->fileName() + ".tmp");
+    QFile indexTmp(idx.indexFile->fileName() + ".tmp");
+    if (!tmp.open(QIODevice::WriteOnly | QIODevice::Truncate) ||
+            !indexTmp.open(QIODevice::WriteOnly | QIODevice::Truncate))
+    {
+        return;
+    }
+
+    QDataStream out(&tmp);
+    out.setVersion(streamVersion);
+    out << fileMagic << fileVersion;
+    QDataStream indexOut(&indexTmp);
+    indexOut.setVersion(streamVersion);
+    indexOut << indexMagic << fileVersion;
+
+    qint64 end = headerSize;
+    for (auto i = idx.entries.begin(); i != idx.entries.end(); ) {
+        if (expired(*i)) {
+            i = idx.entries.erase(i);
+            continue;
+        }
+
+        idx.file->seek(i->offset);
+        auto record = idx.file->read(sizeof(i->size) + i->size);
+        tmp.write(record);
+        i->offset = end;
+        indexOut << i.key() << i->offset << i->stored << i->size;
+        end += record.size();
+        i++;
+    }
+    tmp.close();
+    indexTmp.close();
+
+    replaceWith(*idx.file, tmp);
+    replaceWith(*idx.indexFile, indexTmp);
+    idx.end = end;
+    idx.indexEnd = headerSize + idx.entries.size() * indexEntrySize;
+    idx.dead = 0;
+}
+
+void PublicationDiskCache::enforceSizeLimit(const QByteArray &keep)
+{
+    auto files = dir.entryInfoList(QStringList() << "*.cache", QDir::Files,
+                                   QDir::Time);
+    qint64 total = 0;
+    foreach (auto i, files) {
+        total += i.size() + QFileInfo(indexPath(i)).size();
+    }
+
+    QString keepName = QFileInfo(fileName(keep)).fileName();
+    while (total > maxSize && !files.isEmpty()) {
+        auto oldest = files.takeLast();
+        if (oldest.fileName() == keepName) {
+            continue;
+        }
+
+        auto context = QByteArray::fromHex(oldest.completeBaseName().toLatin1());
+        indices.remove(context);
+        QFileInfo oldestIndex(indexPath(oldest));
+        QFile::remove(oldest.filePath());
+        QFile::remove(oldestIndex.filePath());
+        total -= oldest.size() + oldestIndex.size();
+        qDebug() << "Removed cache file" << oldest.filePath();
+    }
+}
@@ -0,0 +1,61 @@
+#ifndef PUBLICATIONDISKCACHE_H
+#define PUBLICATIONDISKCACHE_H
+
+#include <QHash>
+#include <QDir>
+#include <QFile>
+#include <QSharedPointer>
+#include <QVector>
+
+#include "publication.h"
+
+// Publications stored between sessions. Per query context (endpoint,
+// generated query, date regex) an append-only data file and an index of
+// fixed-size entries keyed by a hash of the IRI. The index is read in one
+// go when the context is first looked up; records are read on a hit.
+class PublicationDiskCache
+{
+public:
+    PublicationDiskCache();
+
+    static PublicationDiskCache *instance();
+
+    void setMaxAge(qint64 secs) { maxAge = secs; }
+    void setMaxSize(qint64 bytes) { maxSize = bytes; }
+
+    // Hits among the IRIs, records read in file order
+    QHash<Identifier, Publication> find(const QByteArray &context,
+                                        const QVector<Identifier> &);
+    void insert(const QByteArray &context, const QList<Publication> &);
+
+private:
+    struct Entry
+    {
+        qint64 offset;
+        qint64 stored;
+        quint32 size;
+    };
+
+    struct Index
+    {
+        Index() : end(0), indexEnd(0), dead(0) { }
+
+        QSharedPointer<QFile> file, indexFile;
+        QHash<quint64, Entry> entries;
+        qint64 end, indexEnd, dead;
+    };
+
+    QString fileName(const QByteArray &context) const;
+    QString indexFileName(const QByteArray &context) const;
+    bool expired(const Entry &) const;
+    bool read(Index &, qint64 offset, const Identifier &, Publication &);
+    Index &index(const QByteArray &context);
+    void compact(Index &);
+    void enforceSizeLimit(const QByteArray &keep);
+
+    QDir dir;
+    QHash<QByteArray, Index> indices;
+    qint64 maxAge, maxSize;
+};
+
+#endif // PUBLICATIONDISKCACHE_H
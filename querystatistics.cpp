@@ -0,0 +1,158 @@
+#include "querystatistics.h"
+
+#include <algorithm>
+
+QueryStatistics::Record::Record()
+    : queueWait(0), timeToFirstByte(-1), latency(-1), publications(0),
+      rows(0), compressedBytes(0), uncompressedBytes(0), failed(false)
+{
+}
+
+const QVector<qint64> &QueryStatistics::bucketLimits()
+{
+    static QVector<qint64> limits;
+    if (limits.isEmpty()) {
+        for (qint64 i = 16; i <= 64 * 1024; i *= 2) {
+            limits.append(i);
+        }
+    }
+    return limits;
+}
+
+void QueryStatistics::clear()
+{
+    queries.clear();
+    wallTime = 0;
+}
+
+QueryStatistics::Record QueryStatistics::totals() const
+{
+    Record sum;
+    sum.timeToFirstByte = sum.latency = 0;
+    for (auto &i : queries) {
+        sum.queueWait += i.queueWait;
+        sum.timeToFirstByte += qMax<qint64>(i.timeToFirstByte, 0);
+        sum.latency += qMax<qint64>(i.latency, 0);
+        sum.publications += i.publications;
+        sum.rows += i.rows;
+        sum.compressedBytes += i.compressedBytes;
+        sum.uncompressedBytes += i.uncompressedBytes;
+    }
+    return sum;
+}
+
+int QueryStatistics::failedCount() const
+{
+    int n = 0;
+    for (auto &i : queries) {
+        if (i.failed) {
+            n++;
+        }
+    }
+    return n;
+}
+
+double QueryStatistics::throughput() const
+{
+    if (wallTime <= 0) {
+        return 0;
+    }
+    return totals().uncompressedBytes * 1000.0 / wallTime;
+}
+
+QVector<int> QueryStatistics::histogram(qint64 Record::*field) const
+{
+    auto &limits = bucketLimits();
+    QVector<int> counts(limits.size() + 1, 0);
+    for (auto &i : queries) {
+        if (i.*field < 0) {
+            continue;
+        }
+        auto bucket = std::lower_bound(limits.begin(), limits.end(), i.*field);
+        counts[bucket - limits.begin()]++;
+    }
+    return counts;
+}
+
+qint64 QueryStatistics::percentile(qint64 Record::*field, int percent) const
+{
+    QVector<qint64> values;
+    for (auto &i : queries) {
+        if (i.*field >= 0) {
+            values.append(i.*field);
+        }
+    }
+    if (values.isEmpty()) {
+        return -1;
+    }
+
+    int n = qMin(values.size() - 1, (values.size() * percent) / 100);
+    std::nth_element(values.begin(), values.begin() + n, values.end());
+    return values[n];
+}
+
+static QByteArray jsonHistogram(const QVector<int> &counts)
+{
+    QByteArray json("{\"limits\":[");
+    auto &limits = QueryStatistics::bucketLimits();
+    for (int i = 0; i < limits.size(); i++) {
+        if (i > 0) {
+            json.append(',');
+        }
+        json.append(QByteArray::number(limits[i]));
+    }
+    json.append("],\"counts\":[");
+    for (int i = 0; i < counts.size(); i++) {
+        if (i > 0) {
+            json.append(',');
+        }
+        json.append(QByteArray::number(counts[i]));
+    }
+    json.append("]}");
+    return json;
+}
+
+// Written by hand, QJsonDocument isn't available with Qt 4
+QByteArray QueryStatistics::toJson() const
+{
+    auto sum = totals();
+
+    QByteArray json("{\n");
+    json.append("\"wallTime\":" + QByteArray::number(wallTime) + ",\n");
+    json.append("\"queries\":" + QByteArray::number(queries.size()) + ",\n");
+    json.append("\"failed\":" + QByteArray::number(failedCount()) + ",\n");
+    json.append("\"publications\":" + QByteArray::number(sum.publications) +
+                ",\n");
+    json.append("\"rows\":" + QByteArray::number(sum.rows) + ",\n");
+    json.append("\"compressedBytes\":" +
+                QByteArray::number(sum.compressedBytes) + ",\n");
+    json.append("\"uncompressedBytes\":" +
+                QByteArray::number(sum.uncompressedBytes) + ",\n");
+    json.append("\"throughput\":" + QByteArray::number(throughput(), 'f', 1) +
+                ",\n");
+    json.append("\"latency\":" + jsonHistogram(histogram(&Record::latency)) +
+                ",\n");
+    json.append("\"timeToFirstByte\":" +
+                jsonHistogram(histogram(&Record::timeToFirstByte)) + ",\n");
+    json.append("\"queueWait\":" +
+                jsonHistogram(histogram(&Record::queueWait)) + ",\n");
+
+    json.append("\"records\":[\n");
+    for (int i = 0; i < queries.size(); i++) {
+        auto &r = queries[i];
+        json.append("{\"queueWait\":" + QByteArray::number(r.queueWait) +
+                    ",\"timeToFirstByte\":" +
+                    QByteArray::number(r.timeToFirstByte) +
+                    ",\"latency\":" + QByteArray::number(r.latency) +
+                    ",\"publications\":" + QByteArray::number(r.publications) +
+                    ",\"rows\":" + QByteArray::number(r.rows) +
+                    ",\"compressedBytes\":" +
+                    QByteArray::number(r.compressedBytes) +
+                    ",\"uncompressedBytes\":" +
+                    QByteArray::number(r.uncompressedBytes) +
+                    ",\"failed\":" + (r.failed ? "true" : "false") + "}");
+        json.append(i + 1 < queries.size() ? ",\n" : "\n");
+    }
+    json.append("]\n}\n");
+    return json;
+}
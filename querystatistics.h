@@ -0,0 +1,54 @@
+#ifndef QUERYSTATISTICS_H
+#define QUERYSTATISTICS_H
+
+#include <QList>
+#include <QVector>
+#include <QByteArray>
+
+// Measurements of every query sent during one Dataset run
+class QueryStatistics
+{
+public:
+    struct Record
+    {
+        Record();
+
+        // Milliseconds. Queue wait is the time the oldest publication of
+        // a batch waited for a slot, the rest is counted from exec()
+        qint64 queueWait, timeToFirstByte, latency;
+        // Publications in a property batch, 0 for the main query
+        int publications;
+        int rows;
+        qint64 compressedBytes, uncompressedBytes;
+        bool failed;
+    };
+
+    // Upper bounds of histogram buckets in ms, the last bucket is open
+    static const QVector<qint64> &bucketLimits();
+
+    QueryStatistics() : wallTime(0) { }
+
+    void clear();
+    void add(const Record &r) { queries.append(r); }
+    void setWallTime(qint64 msecs) { wallTime = msecs; }
+
+    const QList<Record> &records() const { return queries; }
+    qint64 wallTimeMsecs() const { return wallTime; }
+
+    // Sums over all queries; times are sums as well
+    Record totals() const;
+    int failedCount() const;
+    // Decoded bytes per second of wall time
+    double throughput() const;
+
+    QVector<int> histogram(qint64 Record::*field) const;
+    qint64 percentile(qint64 Record::*field, int percent) const;
+
+    QByteArray toJson() const;
+
+private:
+    QList<Record> queries;
+    qint64 wallTime;
+};
+
+#endif // QUERYSTATISTICS_H
@@ -0,0 +1,66 @@
+#include "rdffileloader.h"
+#include "turtleparser.h"
+
+static const qint64 chunkSize = 1024 * 1024;
+
+RdfFileLoader::RdfFileLoader(const QString &fileName,
+                             const QSet<QString> &predicates)
+    : file(fileName),
+      decompressor(fileName.endsWith(".gz") ? Decompressor::Gzip
+                                            : Decompressor::Identity),
+      parser(new TurtleParser(predicates)), done(false)
+{
+    qRegisterMetaType<SparqlQuery::Results>("SparqlQuery::Results");
+}
+
+RdfFileLoader::~RdfFileLoader()
+{
+}
+
+void RdfFileLoader::fail(const QString &err)
+{
+    done = true;
+    emit triples(SparqlQuery::Results(), true,
+                 file.fileName() + ": " + err);
+}
+
+void RdfFileLoader::readChunk()
+{
+    if (done) {
+        return;
+    }
+
+    if (!file.isOpen() && !file.open(QIODevice::ReadOnly)) {
+        fail(file.errorString());
+        return;
+    }
+
+    auto bytes = file.read(chunkSize);
+    if (bytes.isEmpty() && file.error() != QFile::NoError) {
+        fail(file.errorString());
+        return;
+    }
+
+    QByteArray decoded;
+    if (!decompressor.decompress(bytes, decoded)) {
+        fail(decompressor.errorString());
+        return;
+    }
+
+    parser->addData(decoded);
+    if (file.atEnd()) {
+        if (!decompressor.atEnd()) {
+            fail("Compressed file is truncated");
+            return;
+        }
+        parser->finish();
+        done = true;
+    }
+
+    if (parser->hasError()) {
+        fail(parser->errorString());
+        return;
+    }
+
+    emit triples(parser->takeResults(), done, QString());
+}
@@ -0,0 +1,40 @@
+#ifndef RDFFILELOADER_H
+#define RDFFILELOADER_H
+
+#include <QObject>
+#include <QFile>
+#include <QSet>
+#include <QScopedPointer>
+
+#include "sparqlquery.h"
+#include "decompressor.h"
+
+class TurtleParser;
+
+// Streams a local N-Triples or Turtle dump (optionally gzipped) on the
+// worker thread. Every readChunk() parses one block of the file and emits
+// triples with the wanted predicates as ?s ?p ?o rows, the same shape
+// property queries return, so memory use doesn't grow with the dump.
+class RdfFileLoader : public QObject
+{
+    Q_OBJECT
+public:
+    RdfFileLoader(const QString &fileName, const QSet<QString> &predicates);
+    virtual ~RdfFileLoader();
+
+public slots:
+    void readChunk();
+
+signals:
+    void triples(const SparqlQuery::Results &, bool end, const QString &error);
+
+private:
+    void fail(const QString &);
+
+    QFile file;
+    Decompressor decompressor;
+    QScopedPointer<TurtleParser> parser;
+    bool done;
+};
+
+#endif // RDFFILELOADER_H
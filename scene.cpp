@@ -1,17 +1,18 @@
 #include "scene.h"
 
 #include <limits>
+#include <algorithm>
 
 #include <QDebug>
 #include <QMutableSetIterator>
 #include <QMutableHashIterator>
 #include <QMutableMapIterator>
-#include <QMutableLinkedListIterator>
 #include <QVector>
 #include <QFontMetricsF>
 #include <QElapsedTimer>
 #include <QGraphicsView>
 #include <QGraphicsSceneMouseEvent>
+#include <QtConcurrentMap>
 
 #include <QtAlgorithms>
 #include <qmath.h>
@@ -59,109 +60,87 @@ Scene::Scene(QObject *parent) :
     parameters[YearFontSize] = 10;
 
     randomize = false;
+    layoutRuns = 1;
+    seed = 0;
 
     setBackgroundBrush(QColor::fromRgbF(1, 1, 1));
     setItemIndexMethod(QGraphicsScene::NoIndex);
 }
 
-static int intersectionNumber(const QVector<int> &a, const QVector<int> &b)
+inline bool updateIndices(LayeredGraph::Layer &layer)
 {
-    if (a.isEmpty() || b.isEmpty() || a.back() <= b.front()) {
-        return 0;
-    }
-    if (b.back() < a.front()) {
-        return a.size() * b.size();
-    }
-
-    int result = 0;
-    int i = 0, j = 0;
-    while (i < a.size() && j < b.size()) {
-        while (j < b.size() && b[j] < a[i]) {
-            j++;
-        }
-        result += j;
-        i++;
-    }
-    return result + b.size() * (a.size() - i);
-}
-
-static void sortedNeighbors(const VNodeRef &n, int side)
-{
-    n->neighborIndices[side].resize(0);
-    for (auto &i : n->neighbors[side]) {
-        if (i->indexInLayer >= 0) {
-            n->neighborIndices[side].push_back(i->indexInLayer);
-        }
-    }
-    qSort(n->neighborIndices[side]);
-}
-
-inline bool updateIndices(Scene::Layer &layer)
-{
-    int idx = 0;
     bool change = false;
-    for (auto &n : layer) {
-        change = change || (n->indexInLayer != idx);
-        n->indexInLayer = idx++;
+    for (int p = 0; p < layer.count(); p++) {
+        change = change || (layer.position[layer.order[p]] != p);
+        layer.position[layer.order[p]] = p;
     }
     return change;
 }
 
-inline void updateNeighbors(Scene::Layer &layer, bool l, bool r)
+inline void updateNeighbors(LayeredGraph &graph, int layer, bool l, bool r)
 {
-    for (auto &n : layer) {
-        if (l) {
-            sortedNeighbors(n, 0);
-        }
-        if (r) {
-            sortedNeighbors(n, 1);
-        }
+    if (l) {
+        graph.sortNeighbors(layer, 0);
+    }
+    if (r) {
+        graph.sortNeighbors(layer, 1);
     }
 }
 
-inline int swapNodesDiff(const VNodeRef &a, const VNodeRef &b, int side)
-{
-    return intersectionNumber(b->neighborIndices[side],
-                              a->neighborIndices[side])
-            - intersectionNumber(a->neighborIndices[side],
-                                 b->neighborIndices[side]);
-}
-
-static void insertNodes(Scene::Layer &layer, bool l, bool twosided = false)
+static void insertNodes(LayeredGraph::Layer &layer, bool l,
+                        bool twosided = false)
 {
-    for (auto &n : layer) {
-        n->updated = !n->moveable;
+    auto &order = layer.order;
+    QVector<bool> updated(layer.count());
+    for (int v = 0; v < layer.count(); v++) {
+        updated[v] = !layer.moveable[v];
+    }
+
+    // Costs of each candidate position are table lookups per edge
+    // instead of merging neighbour lists for every pair
+    bool useSide[2] = { l || twosided, !l || twosided };
+    QVector<int> tables[2];
+    for (int side = 0; side < 2; side++) {
+        if (useSide[side]) {
+            tables[side].resize(layer.positionCount(side));
+        }
     }
 
     int idx = 0;
-    for (auto n = layer.begin(); n != layer.end(); ) {
-        if ((*n)->updated) {
-            n++;
+    while (idx < order.size()) {
+        int n = order[idx];
+        if (updated[n]) {
             idx++;
             continue;
         }
 
+        bool active[2];
+        for (int side = 0; side < 2; side++) {
+            active[side] = useSide[side] && layer.degree(side, n) > 0;
+            if (active[side]) {
+                layer.fillSwapTable(side, n, tables[side]);
+            }
+        }
+
+        // Position of n in the layer without n that gives least crossings
         long long left = 0, right = 0;
-        auto j = layer.begin();
-        auto best = j;
-        auto next = n + 1;
         auto bestLeft = left, bestRight = right;
         int jIdx = 0, bestIdx = 0;
-        while (j != layer.end()) {
-            if ((*j)->updated) {
-                if (l || twosided) {
-                    left += swapNodesDiff(*n, *j, 0);
+        for (int k = 0; k < order.size(); k++) {
+            int j = order[k];
+            if (updated[j]) {
+                if (active[0]) {
+                    left += layer.swapNodesDiff(0, j, tables[0]);
                 }
-                if (!l || twosided) {
-                    right += swapNodesDiff(*n, *j, 1);
+                if (active[1]) {
+                    right += layer.swapNodesDiff(1, j, tables[1]);
                 }
             }
 
-            if (j != n) {
+            if (k != idx) {
                 ++jIdx;
             }
 
-            ++j;
             if (left + right < bestLeft + bestRight ||
                     (left + right == bestLeft + bestRight &&
                      ((l && left < bestLeft) ||
@@ -171,192 +150,324 @@ static void insertNodes(Scene::Layer &layer, bool l, bool twosided = false)
             {
                 bestLeft = left;
                 bestRight = right;
-                best = j;
                 bestIdx = jIdx;
             }
         }
 
-        (*n)->updated = true;
-        if (n != best && next != best) {
-            layer.insert(best, *n);
-            n = layer.erase(n);
-            if (bestIdx < idx) {
-                idx++;
-            }
+        updated[n] = true;
+        if (bestIdx < idx) {
+            std::rotate(order.begin() + bestIdx, order.begin() + idx,
+                        order.begin() + idx + 1);
+            idx++;
+        } else if (bestIdx > idx) {
+            std::rotate(order.begin() + idx, order.begin() + idx + 1,
+                        order.begin() + bestIdx + 1);
         } else {
-            n = next;
             idx++;
         }
     }
 
-    Q_ASSERT(idx == layer.size());
+    Q_ASSERT(idx == layer.count());
 
     updateIndices(layer);
 }
 
-static long long intersections(Scene::Layer &layer, bool l, bool r)
+static long long intersections(const LayeredGraph::Layer &layer, bool l,
+                               bool r)
 {
     long long result = 0;
-    for (auto i = layer.begin(); i != layer.end(); i++) {
-        for (auto j = layer.begin(); j != i; j++) {
-            if (l) {
-                result += intersectionNumber((*j)->neighborIndices[0],
-                        (*i)->neighborIndices[0]);
-            }
-            if (r) {
-                result += intersectionNumber((*j)->neighborIndices[1],
-                        (*i)->neighborIndices[1]);
-            }
-        }
+    if (l) {
+        result += layer.crossings(0);
     }
-    return result;
-}
-
-long long Scene::intersections()
-{
-    long long result = 0;
-    for (auto &l : layers) {
-        updateNeighbors(l, true, false);
-        result += ::intersections(l, true, false);
+    if (r) {
+        result += layer.crossings(1);
     }
     return result;
 }
 
-static qreal barycenter(const VNodeRef &a, bool dir)
+// Below this many edges the thread pool costs more than it saves
+static const int minParallelEdges = 16 * 1024;
+
+// Refreshes one layer's left neighbour positions and counts its crossings.
+// A layer only reads the positions of its left neighbour and writes its
+// own sorted positions, so layers can be processed in parallel.
+struct LayerIntersections
 {
-    qreal z = 0;
-    for (auto &i : a->neighborIndices[dir]) {
-        z += i;
-    }
-    if (a->neighborIndices[dir].isEmpty()) {
-        return a->indexInLayer;
-    } else {
-        return z / a->neighborIndices[dir].size();
-    }
-}
+    typedef long long result_type;
 
-struct BarycenterCompare {
-    BarycenterCompare(bool dir) : dir(dir) { }
+    LayerIntersections(LayeredGraph *graph) : graph(graph) { }
 
-    bool operator()(const VNodeRef &a, const VNodeRef &b) const
+    long long operator()(int i) const
     {
-        return barycenter(a, dir) < barycenter(b, dir);
+        updateNeighbors(*graph, i, true, false);
+        return intersections(graph->layers[i], true, false);
     }
 
 private:
-    bool dir;
+    LayeredGraph *graph;
 };
 
-static void sortByBarycenters(Scene::Layer &i, bool dir)
+static void addIntersections(long long &total, const long long &layer)
 {
-    updateNeighbors(i, !dir, dir);
+    total += layer;
+}
 
-    QVector<VNodeRef> v(i.size());
-    qCopy(i.begin(), i.end(), v.begin());
-    qStableSort(v.begin(), v.end(), BarycenterCompare(dir));
-    i = QLinkedList<VNodeRef>();
-    for (auto &j : v) {
-        i.append(j);
+static long long countIntersections(LayeredGraph &graph, bool parallel)
+{
+    int edges = 0;
+    QVector<int> indices(graph.layers.size());
+    for (int i = 0; i < graph.layers.size(); i++) {
+        indices[i] = i;
+        edges += graph.layers[i].adjacency[0].size();
+    }
+
+    if (!parallel || edges < minParallelEdges) {
+        long long result = 0;
+        for (auto i : indices) {
+            result += LayerIntersections(&graph)(i);
+        }
+        return result;
     }
 
-    updateIndices(i);
+    return QtConcurrent::blockingMappedReduced<long long>(
+                indices, LayerIntersections(&graph), addIntersections,
+                QtConcurrent::UnorderedReduce);
 }
 
-static const qreal msecsPerSec = 1000;
+long long Scene::intersections()
+{
+    return countIntersections(graph, true);
+}
 
-void Scene::setDataset(const Dataset &ds, bool barycenter, bool slow)
+static qreal barycenter(const LayeredGraph::Layer &layer, int v, bool dir)
 {
-    if (ds.hasError()) {
-        return;
+    int degree = layer.degree(dir, v);
+    if (degree == 0) {
+        return layer.position[v];
     }
 
-    QElapsedTimer totalTimer;
-    totalTimer.start();
-    steps = 0;
+    qreal z = 0;
+    auto neighbors = layer.sortedNeighbors(dir, v);
+    for (int i = 0; i < degree; i++) {
+        z += neighbors[i];
+    }
+    return z / degree;
+}
 
-    publications = ds.publications();
-    qDebug() << "Publications:" << publications.size();
+struct BarycenterCompare {
+    BarycenterCompare(const qreal *barycenters) : barycenters(barycenters) { }
 
-    fixPublicationInfoAndDate();
+    bool operator()(int a, int b) const
+    {
+        return barycenters[a] < barycenters[b];
+    }
 
-    findEdgesInsideLayers();
-    arrangeToLayers();
+private:
+    const qreal *barycenters;
+};
 
-    clearAdjacencyData();
+static void sortByBarycenters(LayeredGraph &graph, int i, bool dir)
+{
+    updateNeighbors(graph, i, !dir, dir);
 
-    for (auto i = publicationInfo.begin(); i != publicationInfo.end(); i++) {
-        for (auto &j : publications.find(i.key())->references) {
-            if (i.key() != j && publications.contains(j)) {
-                addEdge(i.key(), j);
+    auto &layer = graph.layers[i];
+    QVector<qreal> barycenters(layer.count());
+    for (int v = 0; v < layer.count(); v++) {
+        barycenters[v] = barycenter(layer, v, dir);
+    }
+    qStableSort(layer.order.begin(), layer.order.end(),
+                BarycenterCompare(barycenters.constData()));
+
+    updateIndices(layer);
+}
+
+// Moves the moveable nodes of every layer to random positions among
+// themselves, fixed nodes stay where they are
+static void shuffle(LayeredGraph &graph, std::mt19937 &random)
+{
+    for (auto &l : graph.layers) {
+        QVector<int> positions, ids;
+        for (int p = 0; p < l.count(); p++) {
+            if (l.moveable[l.order[p]]) {
+                positions.append(p);
+                ids.append(l.order[p]);
             }
         }
-        insertNode(i.key(), LayerId(i->date, subLevels[i.key()]));
+        for (int i = ids.size() - 1; i > 0; i--) {
+            std::uniform_int_distribution<int> pick(0, i);
+            qSwap(ids[i], ids[pick(random)]);
+        }
+        for (int i = 0; i < ids.size(); i++) {
+            l.order[positions[i]] = ids[i];
+        }
+        updateIndices(l);
     }
+}
 
-    removeOldNodes();
+// One crossing minimisation on its own copy of the layers. Runs share
+// nothing but the VNodes they don't touch, so they can run concurrently.
+// A single run counts crossings on the pool itself, several runs already
+// keep it busy.
+struct LayoutRun
+{
+    LayeredGraph graph;
+    quint32 seed;
+    bool shuffle, barycenter, slow, parallel;
+    int steps;
+    long long intersections;
+};
+
+static void minimizeCrossings(LayoutRun &run)
+{
+    auto &graph = run.graph;
+    int nLayers = graph.layers.size();
+    run.steps = 0;
+
+    if (run.shuffle) {
+        std::mt19937 random(run.seed);
+        shuffle(graph, random);
+    }
 
-    if (barycenter) {
-        for (auto &i : layers) {
-            sortByBarycenters(i, false);
+    if (run.barycenter) {
+        for (int i = 0; i < nLayers; i++) {
+            sortByBarycenters(graph, i, false);
         }
 
         long long prev = 0, cur = 0;
-        if (slow) {
-            cur = intersections();
+        if (run.slow) {
+            cur = countIntersections(graph, run.parallel);
         }
         do {
             prev = cur;
-            for (auto i = layers.end(); i != layers.begin();) {
-                --i;
-                sortByBarycenters(*i, true);
+            for (int i = nLayers - 1; i >= 0; i--) {
+                sortByBarycenters(graph, i, true);
             }
-            for (auto &i : layers) {
-                sortByBarycenters(i, false);
+            for (int i = 0; i < nLayers; i++) {
+                sortByBarycenters(graph, i, false);
             }
-            if (slow) {
-                cur = intersections();
+            if (run.slow) {
+                cur = countIntersections(graph, run.parallel);
             }
-            steps++;
+            run.steps++;
         } while (cur < prev);
 
-        absoluteCoords();
-
-        timeElapsed = totalTimer.elapsed() / msecsPerSec;
+        run.intersections = countIntersections(graph, run.parallel);
         return;
     }
 
-    for (auto &i : layers) {
-        updateNeighbors(i, true, false);
-        insertNodes(i, true);
+    for (int i = 0; i < nLayers; i++) {
+        updateNeighbors(graph, i, true, false);
+        insertNodes(graph.layers[i], true);
     }
 
     long long cur = 0, best = 0;
-    if (slow) {
-        cur = intersections();
+    if (run.slow) {
+        cur = countIntersections(graph, run.parallel);
     }
 
     for (bool twosided = false; ; twosided = true) {
         do {
             best = cur;
-            for (auto i = layers.end(); i != layers.begin(); ) {
-                --i;
-                updateNeighbors(*i, twosided, true);
-                insertNodes(*i, false, twosided);
+            for (int i = nLayers - 1; i >= 0; i--) {
+                updateNeighbors(graph, i, twosided, true);
+                insertNodes(graph.layers[i], false, twosided);
             }
-            for (auto &i : layers) {
-                updateNeighbors(i, true, twosided);
-                insertNodes(i, true, twosided);
+            for (int i = 0; i < nLayers; i++) {
+                updateNeighbors(graph, i, true, twosided);
+                insertNodes(graph.layers[i], true, twosided);
             }
-            if (slow) {
-                cur = intersections();
+            if (run.slow) {
+                cur = countIntersections(graph, run.parallel);
             }
-            steps++;
+            run.steps++;
         } while (best - cur > best / (twosided ? 500 : 50));
 
         if (twosided) break;
     }
-    qDebug() << "Steps" << steps;
 
+    run.intersections = countIntersections(graph, run.parallel);
+}
+
+static const qreal msecsPerSec = 1000;
+
+// Identifier hashes follow the order results arrived in. Nodes are
+// inserted in IRI order instead, so a dataset always gets the same layout.
+template<typename T>
+static QList<Identifier> sortedKeys(const QHash<Identifier, T> &hash)
+{
+    auto keys = hash.keys();
+    qSort(keys);
+    return keys;
+}
+
+void Scene::setDataset(const Dataset &ds, bool barycenter, bool slow)
+{
+    if (ds.hasError()) {
+        return;
+    }
+
+    QElapsedTimer totalTimer;
+    totalTimer.start();
+    steps = 0;
+    insertionRandom.seed(seed);
+
+    publications = ds.publications();
+    failed = ds.failedPublications();
+    qDebug() << "Publications:" << publications.size();
+
+    fixPublicationInfoAndDate();
+
+    findEdgesInsideLayers();
+    arrangeToLayers();
+
+    clearAdjacencyData();
+
+    foreach (auto i, sortedKeys(publicationInfo)) {
+        auto references = publications.find(i)->references.toList();
+        qSort(references);
+        foreach (auto j, references) {
+            if (i != j && publications.contains(j)) {
+                addEdge(i, j);
+            }
+        }
+        insertNode(i, LayerId(publicationInfo[i].date, subLevels[i]));
+    }
+
+    removeOldNodes();
+
+    graph.build(layers.values());
+
+    // Run 0 starts from the current order, the others from seeded shuffles
+    QVector<LayoutRun> runs(qMax(1, layoutRuns));
+    std::mt19937 seeds(seed);
+    for (int i = 0; i < runs.size(); i++) {
+        runs[i].graph = graph;
+        runs[i].seed = seeds();
+        runs[i].shuffle = i > 0;
+        runs[i].barycenter = barycenter;
+        runs[i].slow = slow;
+        runs[i].parallel = runs.size() == 1;
+    }
+    if (runs.size() > 1) {
+        QtConcurrent::blockingMap(runs, minimizeCrossings);
+    } else {
+        minimizeCrossings(runs[0]);
+    }
+
+    int bestRun = 0;
+    runIntersections.resize(runs.size());
+    for (int i = 0; i < runs.size(); i++) {
+        runIntersections[i] = runs[i].intersections;
+        if (runs[i].intersections < runs[bestRun].intersections) {
+            bestRun = i;
+        }
+    }
+    graph = runs[bestRun].graph;
+    steps = runs[bestRun].steps;
+    qDebug() << "Steps" << steps << "run" << bestRun << "of" << runs.size()
+             << "intersections" << runIntersections;
+
+    storeOrder();
     absoluteCoords();
 
     timeElapsed = totalTimer.elapsed() / msecsPerSec;
@@ -387,59 +498,73 @@ qreal Scene::minLayerWidth(const VNodeRef &p, bool prev) const
     return w;
 }
 
-static void computeForces(Scene::Layer &l)
+// Keeps the order for the next dataset, which starts from it
+void Scene::storeOrder()
+{
+    int i = 0;
+    for (auto &l : layers) {
+        l = graph.nodesInOrder(i++);
+    }
+}
+
+static void computeForces(LayeredGraph &graph, int i)
 {
-    for (auto &n : l) {
-        if (n->neighbors[0].isEmpty() && n->neighbors[1].isEmpty()) {
-            n->newY = n->y;
+    auto &l = graph.layers[i];
+    for (int v = 0; v < l.count(); v++) {
+        int degree = l.degree(0, v) + l.degree(1, v);
+        if (degree == 0) {
+            l.newY[v] = l.y[v];
             continue;
         }
 
-        n->newY = 0;
-        for (int i = 0; i < 2; i++) {
-            for (auto &r : n->neighbors[i]) {
-                n->newY += r->y;
+        qreal y = 0;
+        for (int side = 0; side < 2; side++) {
+            if (l.degree(side, v) == 0) {
+                continue;
+            }
+            auto &adjacent = graph.layers[side ? i + 1 : i - 1];
+            for (int k = l.offsets[side][v]; k < l.offsets[side][v + 1]; k++) {
+                y += adjacent.y[l.adjacency[side][k]];
             }
         }
-        n->newY /= n->neighbors[0].size() + n->neighbors[1].size();
+        l.newY[v] = y / degree;
     }
 }
 
-qreal Scene::applyForces(Scene::Layer &l)
+static qreal applyForces(LayeredGraph::Layer &l)
 {
-    static QVector<qreal> startY;
-    startY.resize(l.size());
-    for (auto &n : l) {
-        startY[n->indexInLayer] = n->y;
-    }
+    auto startY(l.y);
+    auto &order = l.order;
+    int n = order.size();
 
     bool blockMoved;
     do {
-        for (auto i = l.begin(); i != l.end(); i++) {
-            (*i)->y = (*i)->newY;
-            if (i != l.begin()) {
-                auto minY = (*(i - 1))->y + ((*(i - 1))->size + (*i)->size) / 2;
-                if ((*i)->y < minY) {
-                    (*i)->y = minY;
+        for (int i = 0; i < n; i++) {
+            int v = order[i];
+            l.y[v] = l.newY[v];
+            if (i > 0) {
+                int u = order[i - 1];
+                auto minY = l.y[u] + (l.sizes[u] + l.sizes[v]) / 2;
+                if (l.y[v] < minY) {
+                    l.y[v] = minY;
                 }
             }
         }
 
         blockMoved = false;
-        for (auto i = l.begin(); i != l.end();) {
-            qreal common = (*i)->newY - (*i)->y;
-            auto start = i++;
+        for (int i = 0; i < n;) {
+            qreal common = l.newY[order[i]] - l.y[order[i]];
+            int start = i++;
 
-            int n = 1;
-            while (i != l.end() && (*i)->newY - (*i)->y < common / n) {
-                common += (*i)->newY - (*i)->y;
+            int k = 1;
+            while (i < n && l.newY[order[i]] - l.y[order[i]] < common / k) {
+                common += l.newY[order[i]] - l.y[order[i]];
                 i++;
-                n++;
+                k++;
             }
-            common /= n;
-            while (start != i) {
-                (*start)->newY = (*start)->y + common;
-                start++;
+            common /= k;
+            for (; start != i; start++) {
+                l.newY[order[start]] = l.y[order[start]] + common;
             }
             if (common < -minSceneCoordDelta) {
                 blockMoved = true;
@@ -448,8 +573,8 @@ qreal Scene::applyForces(Scene::Layer &l)
     } while (blockMoved);
 
     qreal maxDelta = 0;
-    for (auto &n : l) {
-        maxDelta = qMax(maxDelta, qAbs(startY[n->indexInLayer] - n->y));
+    for (int v = 0; v < n; v++) {
+        maxDelta = qMax(maxDelta, qAbs(startY[v] - l.y[v]));
     }
     return maxDelta;
 }
@@ -458,13 +583,14 @@ void Scene::absoluteCoords()
 {
     qDebug() << "Called" << __FUNCTION__;
 
-    for (auto &l : layers) {
+    for (auto &l : graph.layers) {
         qreal y = 0;
-        for (auto &n : l) {
-            n->size = 2 * radius(n)
+        for (int v : l.order) {
+            auto &n = l.nodes[v];
+            l.sizes[v] = 2 * radius(n)
                     + parameters[n->publication ? VertexSpacing : EdgeSpacing];
-            n->y = y + n->size / 2;
-            y += n->size;
+            l.y[v] = y + l.sizes[v] / 2;
+            y += l.sizes[v];
         }
     }
 
@@ -472,18 +598,18 @@ void Scene::absoluteCoords()
     qint64 timeout = static_cast<qint64>(parameters[AbsoluteCoordsTime]
                                          * msecsPerSec);
 
+    int nLayers = graph.layers.size();
     timer.start();
     int iter = 0;
     while (iter++ < parameters[AbsoluteCoordsIter]) {
         qreal maxdelta = 0;
-        for (auto &l : layers) {
-            computeForces(l);
-            maxdelta = qMax(maxdelta, applyForces(l));
+        for (int i = 0; i < nLayers; i++) {
+            computeForces(graph, i);
+            maxdelta = qMax(maxdelta, applyForces(graph.layers[i]));
         }
-        for (auto i = layers.end(); i != layers.begin();) {
-            --i;
-            computeForces(*i);
-            maxdelta = qMax(maxdelta, applyForces(*i));
+        for (int i = nLayers - 1; i >= 0; i--) {
+            computeForces(graph, i);
+            maxdelta = qMax(maxdelta, applyForces(graph.layers[i]));
         }
         if (timer.elapsed() > timeout || maxdelta < minSceneCoordDelta) {
             break;
@@ -491,14 +617,15 @@ void Scene::absoluteCoords()
     }
 
     auto minY = std::numeric_limits<qreal>::max();
-    for (auto &l : layers) {
-        for (auto &n : l) {
-            minY = qMin(minY, n->y);
+    for (auto &l : graph.layers) {
+        for (auto y : l.y) {
+            minY = qMin(minY, y);
         }
     }
-    for (auto &l : layers) {
-        for (auto &n : l) {
-            n->y -= minY;
+    for (auto &l : graph.layers) {
+        for (int v = 0; v < l.count(); v++) {
+            l.nodes[v]->y = l.y[v] - minY;
+            l.nodes[v]->size = l.sizes[v];
         }
     }
 
@@ -540,7 +667,16 @@ void Scene::addNodeMarker(const VNodeRef &n, qreal r, const QColor &color)
         ptr->setFlag(QGraphicsItem::ItemIsSelectable);
         ptr->setData(0, n->publication.toString());
     }
-    ptr->setToolTip(publications.find(n->publication)->nonEmptyTitle());
+    auto toolTip = publications.find(n->publication)->nonEmptyTitle();
+    if (failed.contains(n->publication)) {
+        // Title, date and references may be missing or incomplete
+        QPen pen(Qt::red, r / 3, Qt::DashLine);
+        ptr->setPen(pen);
+        toolTip += "\n(properties couldn't be loaded)";
+    } else {
+        ptr->setPen(Qt::NoPen);
+    }
+    ptr->setToolTip(toolTip);
     nodeMarkers.insert(n->publication, ptr);
 }
 
@@ -925,8 +1061,9 @@ qreal Scene::tryPlaceLabel(const QRectF &rect) const
 
 int Scene::computeSubLevel(const Identifier &p, QSet<Identifier> &inStack)
 {
-    if (subLevels.contains(p)) {
-        return subLevels[p];
+    auto found = subLevels.constFind(p);
+    if (found != subLevels.constEnd()) {
+        return *found;
     }
 
     inStack.insert(p);
@@ -954,8 +1091,8 @@ void Scene::arrangeToLayers()
 
     QSet<LayerId> usedLayers;
     QSet<Identifier> inStack;
-    for (auto i = publicationInfo.begin(); i != publicationInfo.end(); i++) {
-        LayerId layer(i->date, computeSubLevel(i.key(), inStack));
+    foreach (auto i, sortedKeys(publicationInfo)) {
+        LayerId layer(publicationInfo[i].date, computeSubLevel(i, inStack));
         if (!layers.contains(layer)) {
             layers.insert(layer, Layer());
         }
@@ -1072,13 +1209,16 @@ void Scene::removeOldNodes()
     int n = 0;
 
     for (auto i = layers.begin(); i != layers.end(); i++) {
-        QMutableLinkedListIterator<VNodeRef> j(*i);
-        while (j.hasNext()) {
-            if (!j.next()->updated) {
-                j.remove();
+        Layer kept;
+        kept.reserve(i->size());
+        for (auto &j : *i) {
+            if (j->updated) {
+                kept.append(j);
+            } else {
                 n++;
             }
         }
+        *i = kept;
     }
 
     qDebug() << "Removed" << n << "nodes";
@@ -1116,11 +1256,12 @@ VNodeRef Scene::insertNode(Identifier publication, const LayerId &layerId,
         expectedRef->edgeEnd = edgeEnd;
         expectedRef->currentLayer = layerId;
 
-        auto it = layer.begin();
+        int pos = 0;
         if (randomize) {
-            for (int pos = qrand() % (layer.size() + 1); pos; pos--) it++;
+            std::uniform_int_distribution<int> pick(0, layer.size());
+            pos = pick(insertionRandom);
         }
-        layer.insert(it, expectedRef);
+        layer.insert(pos, expectedRef);
         return expectedRef;
     } else {
         (*found)->color = color;
@@ -7,14 +7,16 @@
 #include <QSharedPointer>
 #include <QGraphicsLineItem>
 #include <QGraphicsEllipseItem>
-#include <QLinkedList>
 #include <QVariantAnimation>
 #include <QSet>
 #include <QStringList>
 #include <QFontMetricsF>
 
+#include <random>
+
 #include "dataset.h"
 #include "vnode.h"
+#include "layeredgraph.h"
 
 class Scene : public QGraphicsScene
 {
@@ -54,8 +56,13 @@ public:
     };
     qreal parameters[NParameters];
     bool randomize;
+    // Crossing minimisation runs per dataset, the one with the fewest
+    // intersections is shown. Runs after the first start shuffled.
+    int layoutRuns;
+    // Seeds random insertion and shuffles, same seed gives same layout
+    quint32 seed;
 
-    typedef QLinkedList<VNodeRef> Layer;
+    typedef QVector<VNodeRef> Layer;
 
     QString selectedNode() const;
 
@@ -63,6 +70,11 @@ public:
     int publicationCount() const { return nodeMarkers.size(); }
     int improvementSteps() const { return steps; }
     double totalSeconds() const { return timeElapsed; }
+    // Intersections every run ended with
+    const QVector<long long> &layoutRunIntersections() const
+    {
+        return runIntersections;
+    }
 
     void placeLabels();
     void absoluteCoords();
@@ -87,7 +99,7 @@ private:
     void findEdgesInsideLayers();
     void clearAdjacencyData();
     void arrangeToLayers();
-    qreal applyForces(Scene::Layer &l);
+    void storeOrder();
     void yearGrid(const QMap<QString, qreal> &yearMinX,
                   const QMap<QString, qreal> &yearMaxX);
     qreal tryPlaceLabel(const QRectF &) const;
@@ -110,8 +122,12 @@ private:
     QHash<Identifier, PublicationInfo> publicationInfo;
 
     QMap<LayerId, Layer> layers;
+    // Flat copy of layers used by ordering and coordinate assignment
+    LayeredGraph graph;
 
     QHash<Identifier, Publication> publications;
+    // Publications whose properties couldn't be loaded, drawn outlined
+    QSet<Identifier> failed;
     QHash<Identifier, QSet<Identifier> > inLayerEdges;
     QHash<Identifier, int> subLevels;
 
@@ -138,6 +154,8 @@ private:
 
     int steps;
     qreal timeElapsed;
+    QVector<long long> runIntersections;
+    std::mt19937 insertionRandom;
 };
 
 #endif // SCENE_H
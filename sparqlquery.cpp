@@ -1,4 +1,7 @@
 #include "sparqlquery.h"
+#include "sparqlresultsparser.h"
+#include "workerthread.h"
+#include "concurrencycontroller.h"
 
 #include <QNetworkAccessManager>
 #include <QNetworkConfiguration>
@@ -6,11 +9,9 @@
 #   include <QUrlQuery>
 #endif
 
-Q_GLOBAL_STATIC(QNetworkAccessManager, network)
-
-int SparqlQuery::maxParallelQueries()
+int SparqlQuery::maxParallelQueries(const QUrl &endpoint)
 {
-    return 6; //Qt limitation
+    return ConcurrencyController::instance()->limit(endpoint);
 }
 
 static QByteArray encodeQuery(const QString &query)
@@ -28,9 +29,25 @@ static QByteArray encodeQuery(const QString &query)
 
 SparqlQuery::SparqlQuery(const QUrl &endpoint, const QString &query,
                          QObject *parent)
-    : QObject(parent), reply(0), errorTag(false), errorSet(false),
+    : QObject(parent), reply(0), manager(0), reported(false),
+      worker(0), lastDataSent(false),
+      endReached(false), received(0), decoded(0), firstByteMsecs(-1),
+      latencyMsecs(-1), rows(0), errorSet(false),
       endpointUrl(endpoint), postData(encodeQuery(query))
 {
+    qRegisterMetaType<SparqlQuery::Results>("SparqlQuery::Results");
+}
+
+SparqlQuery::~SparqlQuery()
+{
+    if (reply && !reported) {
+        ConcurrencyController::instance()->finished(
+                    endpointUrl, manager, timer.elapsed(),
+                    ConcurrencyController::Cancelled);
+    }
+    if (worker) {
+        worker->deleteLater();
+    }
 }
 
 void SparqlQuery::exec()
@@ -40,8 +57,14 @@ void SparqlQuery::exec()
     QNetworkRequest request(endpointUrl);
     request.setHeader(QNetworkRequest::ContentTypeHeader,
                       "application/x-www-form-urlencoded");
-
-    reply = network()->post(request, postData);
+    request.setRawHeader("Accept", SparqlResultsParser::acceptHeader());
+    // Qt leaves the body compressed when Accept-Encoding is set explicitly,
+    // it is inflated on the worker thread together with parsing
+    request.setRawHeader("Accept-Encoding", Decompressor::acceptEncoding());
+
+    manager = ConcurrencyController::instance()->started(endpointUrl);
+    timer.start();
+    reply = manager->post(request, postData);
     reply->setParent(this);
 
     connect(reply, SIGNAL(readyRead()), SLOT(firstDataArrived()));
@@ -54,52 +77,10 @@ void SparqlQuery::exec()
             SLOT(networkError()));
 }
 
-void SparqlQuery::readData()
-{
-    switch (xml.readNext()) {
-    case QXmlStreamReader::StartElement:
-        if (xml.name() == "binding") {
-            bindingName = xml.attributes().value("name").toString();
-        } else if (xml.name() == "error") {
-            errorTag = true;
-        }
-        return;
-
-    case QXmlStreamReader::EndElement:
-        if (xml.name() == "binding") {
-            bindingName = QString();
-        } else if (xml.name() == "result") {
-            data.append(bindings);
-            bindings.clear();
-        } else if (xml.name() == "error") {
-            setError("<error> tag");
-        }
-        return;
-
-    case QXmlStreamReader::Characters:
-        if (errorTag) {
-            setError(xml.text().toString());
-        } else if (!bindingName.isNull()) {
-            bindings[bindingName] = xml.text().toString();
-        }
-        return;
-
-    case QXmlStreamReader::Invalid:
-        if (xml.error() != QXmlStreamReader::PrematureEndOfDocumentError) {
-            setError(xml.errorString());
-        }
-    case QXmlStreamReader::NoToken:
-        if (reply->error() != QNetworkReply::NoError) {
-            networkError();
-        }
-    default:
-        return;
-    }
-}
-
 void SparqlQuery::firstDataArrived()
 {
     reply->disconnect(this, SLOT(firstDataArrived()));
+    firstByteMsecs = timer.elapsed();
 
     auto status = reply->attribute(QNetworkRequest::HttpStatusCodeAttribute);
     if (status != 200) {
@@ -107,25 +88,56 @@ void SparqlQuery::firstDataArrived()
         return;
     }
 
-    xml.setDevice(reply);
+    auto format = SparqlResultsParser::format(reply->rawHeader("Content-Type"));
+    auto encoding = Decompressor::encoding(
+                reply->rawHeader("Content-Encoding"));
+    worker = new ParserWorker(format, encoding);
+    worker->moveToThread(WorkerThread::instance());
+    connect(worker,
+            SIGNAL(parsed(SparqlQuery::Results,bool,QString,qint64)),
+            SLOT(dataParsed(SparqlQuery::Results,bool,QString,qint64)));
 }
 
 void SparqlQuery::dataArrived()
 {
-    while (!xml.atEnd() && !isFinished()) {
-        readData();
+    if (!worker || isFinished() || lastDataSent) {
+        return;
+    }
+
+    lastDataSent = reply->isFinished() &&
+            reply->error() == QNetworkReply::NoError;
+    auto bytes = reply->readAll();
+    if (bytes.isEmpty() && !lastDataSent) {
+        return;
+    }
+    received += bytes.size();
+
+    QMetaObject::invokeMethod(worker, "addData", Qt::QueuedConnection,
+                              Q_ARG(QByteArray, bytes),
+                              Q_ARG(bool, lastDataSent));
+}
+
+void SparqlQuery::dataParsed(const SparqlQuery::Results &data, bool end,
+                             const QString &err, qint64 decodedBytes)
+{
+    if (isFinished()) {
+        return;
     }
+    decoded = decodedBytes;
 
-    if (hasError()) {
+    if (!err.isEmpty()) {
+        setError(err);
         return;
     }
 
     if (!data.isEmpty()) {
+        rows += data.rowCount();
         emit results(data);
-        data.clear();
     }
 
-    if (endOfResults()) {
+    if (end) {
+        endReached = true;
+        report(true);
         emit finished();
     }
 }
@@ -142,8 +154,42 @@ void SparqlQuery::setError(const QString &err)
     error = err;
     errorSet = true;
 
+    report(false);
     reply->disconnect(this);
     reply->abort();
 
     emit finished();
 }
+
+void SparqlQuery::report(bool success)
+{
+    if (reported) {
+        return;
+    }
+    reported = true;
+    latencyMsecs = timer.elapsed();
+
+    auto outcome = ConcurrencyController::Success;
+    if (!success) {
+        int status = reply->attribute(
+                    QNetworkRequest::HttpStatusCodeAttribute).toInt();
+        switch (reply->error()) {
+        case QNetworkReply::OperationCanceledError:
+            outcome = ConcurrencyController::Cancelled;
+            break;
+        case QNetworkReply::TimeoutError:
+        case QNetworkReply::RemoteHostClosedError:
+            outcome = ConcurrencyController::Overloaded;
+            break;
+        default:
+            outcome = (status == 503 || status == 429)
+                    ? ConcurrencyController::Overloaded
+                    : ConcurrencyController::Failed;
+        }
+    }
+
+    // Failures may come before any byte
+    ConcurrencyController::instance()->finished(
+                endpointUrl, manager,
+                firstByteMsecs >= 0 ? firstByteMsecs : latencyMsecs, outcome);
+}
@@ -4,9 +4,11 @@
 #include <QObject>
 #include <QUrl>
 #include <QNetworkReply>
-#include <QXmlStreamReader>
-#include <QMap>
-#include <QList>
+#include <QElapsedTimer>
+#include <QStringList>
+#include <QVector>
+
+class ParserWorker;
 
 class SparqlQuery : public QObject
 {
@@ -14,7 +16,8 @@ class SparqlQuery : public QObject
 public:
     SparqlQuery(const QUrl &endpoint, const QString &query,
                 QObject *parent = 0);
-    
+    virtual ~SparqlQuery();
+
     const QUrl &endpoint() const { return endpointUrl; }
     bool isExecuted() const { return reply != 0; }
 
@@ -22,15 +25,42 @@ public:
     const QString &errorString() const { return error; }
 
     bool isFinished() const { return hasError() || endOfResults(); }
-    bool endOfResults() const
-    {
-        return xml.tokenType() == QXmlStreamReader::EndDocument;
-    }
+    bool endOfResults() const { return endReached; }
+
+    // Body bytes as transferred and after gzip/deflate decoding
+    qint64 compressedBytes() const { return received; }
+    qint64 uncompressedBytes() const { return decoded; }
 
-    static int maxParallelQueries();
+    // Milliseconds since exec(), -1 until known
+    qint64 timeToFirstByte() const { return firstByteMsecs; }
+    qint64 latency() const { return latencyMsecs; }
+    int rowCount() const { return rows; }
 
-    typedef QMap<QString, QString> Bindings;
-    typedef QList<Bindings> Results;
+    // Current limit of queries in flight for the endpoint
+    static int maxParallelQueries(const QUrl &endpoint);
+
+    // Rows resolved once against the variables from the results head.
+    // Values are stored row after row; unbound values are null strings.
+    struct Results
+    {
+        QStringList variables;
+        QVector<QString> values;
+
+        bool isEmpty() const { return values.isEmpty(); }
+        int columnCount() const { return variables.size(); }
+        int rowCount() const
+        {
+            return variables.isEmpty() ? 0 : values.size() / variables.size();
+        }
+        int column(const QString &variable) const
+        {
+            return variables.indexOf(variable);
+        }
+        const QString &at(int row, int column) const
+        {
+            return values[row * variables.size() + column];
+        }
+    };
 
 public slots:
     void exec();
@@ -44,19 +74,25 @@ private slots:
     void dataArrived();
     void firstDataArrived();
     void networkError();
+    void dataParsed(const SparqlQuery::Results &, bool end,
+                    const QString &error, qint64 decodedBytes);
 
 private:
-    void readData();
     void setError(const QString &);
-
-    Results data;
-    Bindings bindings;
-    QString bindingName;
+    void report(bool success);
 
     QNetworkReply *reply;
-    QXmlStreamReader xml;
-
-    bool errorTag;
+    QNetworkAccessManager *manager;
+    QElapsedTimer timer;
+    bool reported;
+    ParserWorker *worker;
+    bool lastDataSent;
+    bool endReached;
+    qint64 received;
+    qint64 decoded;
+    qint64 firstByteMsecs;
+    qint64 latencyMsecs;
+    int rows;
 
     QString error;
     bool errorSet;
@@ -0,0 +1,567 @@
+#include "sparqlresultsparser.h"
+
+#include <QXmlStreamReader>
+#include <QVector>
+
+static int hexDigit(char c)
+{
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+static bool hexValue(const char *s, int len, uint &v)
+{
+    v = 0;
+    for (int i = 0; i < len; i++) {
+        int d = hexDigit(s[i]);
+        if (d < 0) {
+            return false;
+        }
+        v = v * 16 + d;
+    }
+    return true;
+}
+
+QString SparqlResultsParser::unescape(const char *begin, const char *end)
+{
+    QString result;
+    const char *run = begin;
+    for (auto i = begin; i < end; i++) {
+        if (*i != '\\') {
+            continue;
+        }
+        result.append(QString::fromUtf8(run, i - run));
+        if (++i == end) {
+            run = end;
+            break;
+        }
+
+        uint code;
+        switch (*i) {
+        case 't': result.append(QLatin1Char('\t')); break;
+        case 'n': result.append(QLatin1Char('\n')); break;
+        case 'r': result.append(QLatin1Char('\r')); break;
+        case 'b': result.append(QLatin1Char('\b')); break;
+        case 'f': result.append(QLatin1Char('\f')); break;
+        case 'u':
+            if (end - i > 4 && hexValue(i + 1, 4, code)) {
+                result.append(QChar(code));
+                i += 4;
+            } else {
+                result.append(QLatin1Char(*i));
+            }
+            break;
+        case 'U':
+            if (end - i > 8 && hexValue(i + 1, 8, code)) {
+                result.append(QString::fromUcs4(&code, 1));
+                i += 8;
+            } else {
+                result.append(QLatin1Char(*i));
+            }
+            break;
+        default:
+            result.append(QLatin1Char(*i));
+        }
+        run = i + 1;
+    }
+    result.append(QString::fromUtf8(run, end - run));
+    return result;
+}
+
+class XmlResultsParser : public SparqlResultsParser
+{
+public:
+    XmlResultsParser() : column(-1), errorTag(false) { }
+
+    virtual void addData(const QByteArray &);
+    virtual void finish();
+
+private:
+    void readNext();
+
+    QXmlStreamReader xml;
+    int column;
+    bool errorTag;
+};
+
+static const QString bindingElement("binding");
+static const QString resultElement("result");
+static const QString variableElement("variable");
+static const QString errorElement("error");
+static const QString nameAttribute("name");
+
+void XmlResultsParser::addData(const QByteArray &bytes)
+{
+    xml.addData(bytes);
+    while (!xml.atEnd() && !hasError()) {
+        readNext();
+    }
+}
+
+void XmlResultsParser::finish()
+{
+    if (!atEnd() && !hasError()) {
+        setError("Unexpected end of results");
+    }
+}
+
+void XmlResultsParser::readNext()
+{
+    switch (xml.readNext()) {
+    case QXmlStreamReader::StartElement:
+        if (xml.name() == bindingElement) {
+            auto name = xml.attributes().value(nameAttribute).toString();
+            column = vars.indexOf(name);
+            if (column < 0) {
+                setError("Unknown variable " + name + " in results");
+            }
+        } else if (xml.name() == resultElement) {
+            startRow();
+        } else if (xml.name() == variableElement) {
+            vars.append(xml.attributes().value(nameAttribute).toString());
+        } else if (xml.name() == errorElement) {
+            errorTag = true;
+        }
+        return;
+
+    case QXmlStreamReader::EndElement:
+        if (xml.name() == bindingElement) {
+            column = -1;
+        } else if (xml.name() == resultElement) {
+            endRow();
+        } else if (xml.name() == errorElement) {
+            setError("<error> tag");
+        }
+        return;
+
+    case QXmlStreamReader::Characters:
+        if (errorTag) {
+            setError(xml.text().toString());
+        } else if (column >= 0) {
+            row[column] = xml.text().toString();
+        }
+        return;
+
+    case QXmlStreamReader::EndDocument:
+        endOfResults = true;
+        return;
+
+    case QXmlStreamReader::Invalid:
+        if (xml.error() != QXmlStreamReader::PrematureEndOfDocumentError) {
+            setError(xml.errorString());
+        }
+    default:
+        return;
+    }
+}
+
+// Streaming parser for application/sparql-results+json. Only tracks
+// the nesting needed to find head.vars and results.bindings.
+class JsonResultsParser : public SparqlResultsParser
+{
+public:
+    JsonResultsParser() : expectKey(false) { }
+
+    virtual void addData(const QByteArray &);
+    virtual void finish();
+
+private:
+    struct Level
+    {
+        bool object;
+        QByteArray key;
+    };
+
+    enum Target
+    {
+        Ignored,
+        Variable,
+        BindingValue
+    };
+
+    void parse(bool last);
+    bool inBindings() const;
+    Target target() const;
+
+    QByteArray buffer;
+    QVector<Level> stack;
+    QList<QByteArray> varKeys;
+    bool expectKey;
+};
+
+static bool jsonDelimiter(char c)
+{
+    switch (c) {
+    case ',': case ':': case '{': case '}': case '[': case ']':
+    case ' ': case '\t': case '\r': case '\n':
+        return true;
+    default:
+        return false;
+    }
+}
+
+void JsonResultsParser::addData(const QByteArray &bytes)
+{
+    buffer.append(bytes);
+    parse(false);
+}
+
+void JsonResultsParser::finish()
+{
+    parse(true);
+    if (!atEnd() && !hasError()) {
+        setError("Unexpected end of results");
+    }
+}
+
+bool JsonResultsParser::inBindings() const
+{
+    return stack.size() >= 3 && stack[0].key == "results" &&
+            stack[1].key == "bindings" && !stack[2].object;
+}
+
+JsonResultsParser::Target JsonResultsParser::target() const
+{
+    if (stack.size() == 5 && stack[4].key == "value" && inBindings()) {
+        return BindingValue;
+    }
+    if (stack.size() == 3 && stack[0].key == "head" &&
+            stack[1].key == "vars" && !stack[2].object)
+    {
+        return Variable;
+    }
+    return Ignored;
+}
+
+void JsonResultsParser::parse(bool last)
+{
+    const char *s = buffer.constData();
+    int size = buffer.size();
+    int pos = 0;
+
+    while (!atEnd() && !hasError()) {
+        while (pos < size && (s[pos] == ' ' || s[pos] == '\t' ||
+                              s[pos] == '\r' || s[pos] == '\n'))
+        {
+            pos++;
+        }
+        if (pos == size) {
+            break;
+        }
+
+        char c = s[pos];
+        if (c == '{' || c == '[') {
+            if (c == '{' && stack.size() == 3 && inBindings()) {
+                startRow();
+            }
+            Level level;
+            level.object = (c == '{');
+            stack.append(level);
+            expectKey = level.object;
+            pos++;
+        } else if (c == '}' || c == ']') {
+            if (stack.isEmpty() || stack.last().object != (c == '}')) {
+                setError("Malformed JSON results");
+                break;
+            }
+            if (stack.size() == 4 && inBindings()) {
+                endRow();
+            }
+            stack.pop_back();
+            endOfResults = stack.isEmpty();
+            pos++;
+        } else if (c == ',') {
+            expectKey = !stack.isEmpty() && stack.last().object;
+            pos++;
+        } else if (c == ':') {
+            expectKey = false;
+            pos++;
+        } else if (c == '"') {
+            int end = pos + 1;
+            while (end < size && s[end] != '"') {
+                end += (s[end] == '\\') ? 2 : 1;
+            }
+            if (end >= size) {
+                if (last) {
+                    setError("Malformed JSON results");
+                }
+                break;
+            }
+
+            if (expectKey && !stack.isEmpty()) {
+                stack.last().key = QByteArray(s + pos + 1, end - pos - 1);
+            } else {
+                switch (target()) {
+                case BindingValue: {
+                    int column = varKeys.indexOf(stack[3].key);
+                    if (column < 0) {
+                        setError("Unknown variable " +
+                                 QString::fromUtf8(stack[3].key) +
+                                 " in results");
+                        break;
+                    }
+                    row[column] = unescape(s + pos + 1, s + end);
+                    break;
+                }
+                case Variable:
+                    vars.append(unescape(s + pos + 1, s + end));
+                    varKeys.append(vars.last().toUtf8());
+                    break;
+                default:
+                    break;
+                }
+            }
+            pos = end + 1;
+        } else {
+            // Numbers, true, false and null never carry bindings
+            int end = pos;
+            while (end < size && !jsonDelimiter(s[end])) {
+                end++;
+            }
+            if (end == size && !last) {
+                break;
+            }
+            pos = end;
+        }
+    }
+
+    buffer.remove(0, pos);
+}
+
+// text/tab-separated-values and text/csv
+class DelimitedResultsParser : public SparqlResultsParser
+{
+public:
+    explicit DelimitedResultsParser(bool tsv)
+        : tsv(tsv), separator(tsv ? '\t' : ','), headerRead(false)
+    {
+    }
+
+    virtual void addData(const QByteArray &);
+    virtual void finish();
+
+private:
+    void parse(bool last);
+    int readRecord(const char *s, int pos, int size, bool last);
+    QString term(const QByteArray &) const;
+
+    QByteArray buffer;
+    QList<QByteArray> fields;
+    bool tsv;
+    char separator;
+    bool headerRead;
+};
+
+void DelimitedResultsParser::addData(const QByteArray &bytes)
+{
+    buffer.append(bytes);
+    parse(false);
+}
+
+void DelimitedResultsParser::finish()
+{
+    parse(true);
+    if (!hasError()) {
+        endOfResults = true;
+    }
+}
+
+// Returns position after the record or -1 if the record is incomplete
+int DelimitedResultsParser::readRecord(const char *s, int pos, int size,
+                                       bool last)
+{
+    fields.clear();
+    QByteArray field;
+    bool quoted = false;
+
+    for (int i = pos; i < size; i++) {
+        char c = s[i];
+        if (quoted) {
+            if (c != '"') {
+                field.append(c);
+            } else if (i + 1 == size && !last) {
+                return -1;
+            } else if (i + 1 < size && s[i + 1] == '"') {
+                field.append('"');
+                i++;
+            } else {
+                quoted = false;
+            }
+        } else if (c == '"' && !tsv) {
+            quoted = true;
+        } else if (c == separator) {
+            fields.append(field);
+            field.clear();
+        } else if (c == '\n') {
+            fields.append(field);
+            return i + 1;
+        } else if (c != '\r') {
+            field.append(c);
+        }
+    }
+
+    if (!last) {
+        return -1;
+    }
+    fields.append(field);
+    return size;
+}
+
+QString DelimitedResultsParser::term(const QByteArray &field) const
+{
+    if (!tsv) {
+        return QString::fromUtf8(field);
+    }
+
+    const char *s = field.constData();
+    int size = field.size();
+    if (s[0] == '<' && s[size - 1] == '>') {
+        return QString::fromUtf8(s + 1, size - 2);
+    }
+    if (size > 1 && s[0] == '_' && s[1] == ':') {
+        return QString::fromUtf8(s + 2, size - 2);
+    }
+    if (s[0] == '"') {
+        int end = field.lastIndexOf('"');
+        if (end > 0) {
+            return unescape(s + 1, s + end);
+        }
+    }
+    return QString::fromUtf8(field);
+}
+
+void DelimitedResultsParser::parse(bool last)
+{
+    const char *s = buffer.constData();
+    int size = buffer.size();
+    int pos = 0;
+
+    while (pos < size && !hasError()) {
+        int end = readRecord(s, pos, size, last);
+        if (end < 0) {
+            break;
+        }
+        pos = end;
+
+        if (!headerRead) {
+            foreach (auto i, fields) {
+                auto var = QString::fromUtf8(i).trimmed();
+                if (var.startsWith('?')) {
+                    var.remove(0, 1);
+                }
+                vars.append(var);
+            }
+            headerRead = true;
+            continue;
+        }
+
+        if (fields.size() == 1 && fields.first().isEmpty()) {
+            continue;
+        }
+        if (fields.size() != vars.size()) {
+            setError("Wrong number of columns in results");
+            break;
+        }
+
+        foreach (auto i, fields) {
+            values.append(i.isEmpty() ? QString() : term(i));
+        }
+    }
+
+    buffer.remove(0, pos);
+}
+
+QByteArray SparqlResultsParser::acceptHeader()
+{
+    return "application/sparql-results+json, "
+            "application/sparql-results+xml;q=0.9, "
+            "text/tab-separated-values;q=0.8, "
+            "text/csv;q=0.7, */*;q=0.1";
+}
+
+SparqlResultsParser::Format
+SparqlResultsParser::format(const QByteArray &contentType)
+{
+    auto mime = contentType.split(';').first().trimmed().toLower();
+    if (mime == "application/sparql-results+json" ||
+            mime == "application/json")
+    {
+        return Json;
+    }
+    if (mime == "text/tab-separated-values") {
+        return Tsv;
+    }
+    if (mime == "text/csv") {
+        return Csv;
+    }
+    return Xml;
+}
+
+SparqlResultsParser *SparqlResultsParser::create(Format format)
+{
+    switch (format) {
+    case Json: return new JsonResultsParser();
+    case Tsv: return new DelimitedResultsParser(true);
+    case Csv: return new DelimitedResultsParser(false);
+    default: return new XmlResultsParser();
+    }
+}
+
+SparqlQuery::Results SparqlResultsParser::takeResults()
+{
+    SparqlQuery::Results results;
+    results.variables = vars;
+    results.values.swap(values);
+    return results;
+}
+
+void SparqlResultsParser::setError(const QString &err)
+{
+    if (errorSet) {
+        return;
+    }
+
+    errorSet = true;
+    error = err;
+}
+
+ParserWorker::ParserWorker(SparqlResultsParser::Format format,
+                           Decompressor::Encoding encoding)
+    : parser(SparqlResultsParser::create(format)), decompressor(encoding),
+      decodedBytes(0), failed(false)
+{
+}
+
+void ParserWorker::addData(const QByteArray &bytes, bool last)
+{
+    if (failed || parser->atEnd() || parser->hasError()) {
+        return;
+    }
+
+    QByteArray decoded;
+    if (!decompressor.decompress(bytes, decoded)) {
+        failed = true;
+        emit parsed(SparqlQuery::Results(), false,
+                    "Can't decompress results: " +
+                    decompressor.errorString(), decodedBytes);
+        return;
+    }
+    decodedBytes += decoded.size();
+
+    parser->addData(decoded);
+    if (last) {
+        if (!decompressor.atEnd()) {
+            failed = true;
+            emit parsed(SparqlQuery::Results(), false,
+                        "Compressed results are truncated", decodedBytes);
+            return;
+        }
+        parser->finish();
+    }
+
+    emit parsed(parser->takeResults(), parser->atEnd(),
+                parser->hasError() ? parser->errorString() : QString(),
+                decodedBytes);
+}
@@ -0,0 +1,88 @@
+#ifndef SPARQLRESULTSPARSER_H
+#define SPARQLRESULTSPARSER_H
+
+#include <QObject>
+#include <QByteArray>
+#include <QString>
+#include <QStringList>
+#include <QScopedPointer>
+
+#include "sparqlquery.h"
+#include "decompressor.h"
+
+class SparqlResultsParser
+{
+public:
+    enum Format
+    {
+        Xml,
+        Json,
+        Tsv,
+        Csv
+    };
+
+    static QByteArray acceptHeader();
+    static Format format(const QByteArray &contentType);
+    static SparqlResultsParser *create(Format);
+
+    // JSON and Turtle string escapes
+    static QString unescape(const char *begin, const char *end);
+
+    virtual ~SparqlResultsParser() { }
+
+    // Parses as much of the data as possible, keeps incomplete tail
+    virtual void addData(const QByteArray &) = 0;
+    // No more data will arrive
+    virtual void finish() = 0;
+
+    bool atEnd() const { return endOfResults; }
+    bool hasError() const { return errorSet; }
+    const QString &errorString() const { return error; }
+
+    const QStringList &variables() const { return vars; }
+
+    bool hasResults() const { return !values.isEmpty(); }
+    SparqlQuery::Results takeResults();
+
+protected:
+    SparqlResultsParser() : endOfResults(false), errorSet(false) { }
+
+    void setError(const QString &);
+
+    void startRow() { row.fill(QString(), vars.size()); }
+    void endRow() { values += row; }
+
+    QStringList vars;
+    QVector<QString> row;
+    QVector<QString> values;
+    bool endOfResults;
+
+private:
+    QString error;
+    bool errorSet;
+};
+
+// Owns a parser on the worker thread. SparqlQuery feeds it raw reply data
+// through queued calls and gets parsed rows back through parsed(), along
+// with the number of bytes decoded so far.
+class ParserWorker : public QObject
+{
+    Q_OBJECT
+public:
+    ParserWorker(SparqlResultsParser::Format, Decompressor::Encoding);
+
+public slots:
+    void addData(const QByteArray &, bool last);
+
+signals:
+    void parsed(const SparqlQuery::Results &, bool end, const QString &error,
+                qint64 decodedBytes);
+
+private:
+    QScopedPointer<SparqlResultsParser> parser;
+    Decompressor decompressor;
+    qint64 decodedBytes;
+    bool failed;
+};
+
+#endif // SPARQLRESULTSPARSER_H
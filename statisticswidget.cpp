@@ -0,0 +1,111 @@
+#include "statisticswidget.h"
+
+#include <QVBoxLayout>
+#include <QFileDialog>
+#include <QFile>
+#include <QDebug>
+
+StatisticsWidget::StatisticsWidget(QWidget *parent)
+    : QWidget(parent)
+{
+    model = new QStandardItemModel(this);
+    view = new QTreeView(this);
+    view->setModel(model);
+    view->setEditTriggers(QAbstractItemView::NoEditTriggers);
+
+    exportButton = new QPushButton(QIcon::fromTheme("document-save-as"),
+                                   "Export &JSON...", this);
+    exportButton->setEnabled(false);
+    connect(exportButton, SIGNAL(clicked()), SLOT(exportJson()));
+
+    auto layout = new QVBoxLayout(this);
+    setLayout(layout);
+    layout->addWidget(view);
+    layout->addWidget(exportButton);
+
+    clear();
+}
+
+void StatisticsWidget::clear()
+{
+    statistics.clear();
+    model->clear();
+    model->setHorizontalHeaderLabels(QStringList() << "Metric" << "Value");
+    exportButton->setEnabled(false);
+}
+
+void StatisticsWidget::addRow(QStandardItem *parent, const QString &name,
+                              const QString &value)
+{
+    parent->appendRow(QList<QStandardItem*>() << new QStandardItem(name)
+                      << new QStandardItem(value));
+}
+
+void StatisticsWidget::setStatistics(const QueryStatistics &s)
+{
+    clear();
+    statistics = s;
+
+    auto sum = s.totals();
+    int n = s.records().size();
+
+    auto root = model->invisibleRootItem();
+    addRow(root, "Wall time", QString("%1 ms").arg(s.wallTimeMsecs()));
+    addRow(root, "Queries", QString::number(n));
+    addRow(root, "Failed queries", QString::number(s.failedCount()));
+    addRow(root, "Publications requested", QString::number(sum.publications));
+    addRow(root, "Rows", QString::number(sum.rows));
+    addRow(root, "Bytes received", QString::number(sum.compressedBytes));
+    addRow(root, "Bytes decoded", QString::number(sum.uncompressedBytes));
+    addRow(root, "Throughput", QString("%1 KB/s").arg(
+               s.throughput() / 1024, 0, 'f', 1));
+
+    addHistogram("Latency", &QueryStatistics::Record::latency);
+    addHistogram("Time to first byte",
+                 &QueryStatistics::Record::timeToFirstByte);
+    addHistogram("Queue wait", &QueryStatistics::Record::queueWait);
+
+    view->expandToDepth(0);
+    view->resizeColumnToContents(0);
+    exportButton->setEnabled(n > 0);
+}
+
+void StatisticsWidget::addHistogram(const QString &name,
+                                    qint64 QueryStatistics::Record::*field)
+{
+    QList<QStandardItem*> row;
+    row << new QStandardItem(name)
+        << new QStandardItem(QString("median %1 ms, 95% %2 ms").arg(
+                                 statistics.percentile(field, 50)).arg(
+                                 statistics.percentile(field, 95)));
+    model->appendRow(row);
+
+    auto &limits = QueryStatistics::bucketLimits();
+    auto counts = statistics.histogram(field);
+    for (int i = 0; i < counts.size(); i++) {
+        if (counts[i] == 0) {
+            continue;
+        }
+        QString bucket = i < limits.size()
+                ? QString("<= %1 ms").arg(limits[i])
+                : QString("> %1 ms").arg(limits.last());
+        addRow(row.first(), bucket, QString::number(counts[i]));
+    }
+}
+
+void StatisticsWidget::exportJson()
+{
+    auto fileName = QFileDialog::getSaveFileName(this, "Export statistics",
+                                                 QString(),
+                                                 "JSON (*.json)");
+    if (fileName.isEmpty()) {
+        return;
+    }
+
+    QFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate) ||
+            file.write(statistics.toJson()) < 0)
+    {
+        qWarning() << "Can't write" << fileName << file.errorString();
+    }
+}
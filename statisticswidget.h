@@ -0,0 +1,35 @@
+#ifndef STATISTICSWIDGET_H
+#define STATISTICSWIDGET_H
+
+#include <QWidget>
+#include <QStandardItemModel>
+#include <QTreeView>
+#include <QPushButton>
+
+#include "querystatistics.h"
+
+class StatisticsWidget : public QWidget
+{
+    Q_OBJECT
+public:
+    explicit StatisticsWidget(QWidget *parent = 0);
+
+public slots:
+    void setStatistics(const QueryStatistics &);
+    void clear();
+
+private slots:
+    void exportJson();
+
+private:
+    void addHistogram(const QString &name, qint64 QueryStatistics::Record::*);
+    void addRow(QStandardItem *parent, const QString &name,
+                const QString &value);
+
+    QueryStatistics statistics;
+    QStandardItemModel *model;
+    QTreeView *view;
+    QPushButton *exportButton;
+};
+
+#endif // STATISTICSWIDGET_H
@@ -0,0 +1,18 @@
+QT       += core gui testlib
+
+TARGET = tst_crossings
+CONFIG += console testcase
+CONFIG -= app_bundle
+TEMPLATE = app
+
+QMAKE_CXXFLAGS += -std=c++0x
+
+INCLUDEPATH += ../..
+
+SOURCES += tst_crossings.cpp \
+    ../../layeredgraph.cpp \
+    ../../identifier.cpp
+
+HEADERS += ../../layeredgraph.h \
+    ../../vnode.h \
+    ../../identifier.h
@@ -0,0 +1,225 @@
+#include <QtTest>
+
+#include <random>
+
+#include "layeredgraph.h"
+
+// The pairwise counter the accumulator tree replaced: for nodes a before
+// b, edges of a ending strictly below edges of b
+static int intersectionNumber(const int *a, int na, const int *b, int nb)
+{
+    if (na == 0 || nb == 0 || a[na - 1] <= b[0]) {
+        return 0;
+    }
+    if (b[nb - 1] < a[0]) {
+        return na * nb;
+    }
+
+    int result = 0;
+    int i = 0, j = 0;
+    while (i < na && j < nb) {
+        while (j < nb && b[j] < a[i]) {
+            j++;
+        }
+        result += j;
+        i++;
+    }
+    return result + nb * (na - i);
+}
+
+static long long pairwiseCrossings(const LayeredGraph::Layer &layer, int side)
+{
+    long long result = 0;
+    for (int i = 0; i < layer.count(); i++) {
+        for (int j = 0; j < i; j++) {
+            int a = layer.order[j], b = layer.order[i];
+            result += intersectionNumber(layer.sortedNeighbors(side, a),
+                                         layer.degree(side, a),
+                                         layer.sortedNeighbors(side, b),
+                                         layer.degree(side, b));
+        }
+    }
+    return result;
+}
+
+// Every pair of edges from nodes in order, no shortcuts
+static long long bruteForceCrossings(const LayeredGraph::Layer &layer,
+                                     int side)
+{
+    long long result = 0;
+    for (int i = 0; i < layer.count(); i++) {
+        for (int j = i + 1; j < layer.count(); j++) {
+            int a = layer.order[i], b = layer.order[j];
+            auto x = layer.sortedNeighbors(side, a);
+            auto y = layer.sortedNeighbors(side, b);
+            for (int k = 0; k < layer.degree(side, a); k++) {
+                for (int m = 0; m < layer.degree(side, b); m++) {
+                    if (y[m] < x[k]) {
+                        result++;
+                    }
+                }
+            }
+        }
+    }
+    return result;
+}
+
+static void shuffledOrder(LayeredGraph::Layer &layer, int count,
+                          std::mt19937 &random)
+{
+    layer.order.resize(count);
+    layer.position.resize(count);
+    for (int i = 0; i < count; i++) {
+        layer.order[i] = i;
+    }
+    for (int i = count - 1; i > 0; i--) {
+        std::uniform_int_distribution<int> pick(0, i);
+        qSwap(layer.order[i], layer.order[pick(random)]);
+    }
+    for (int i = 0; i < count; i++) {
+        layer.position[layer.order[i]] = i;
+    }
+}
+
+// Layer 1 has edges to layer 0 only, both in random order
+static LayeredGraph randomBilayer(int upper, int lower, int maxDegree,
+                                  std::mt19937 &random)
+{
+    LayeredGraph graph;
+    graph.layers.resize(2);
+    auto &prev = graph.layers[0];
+    auto &layer = graph.layers[1];
+    shuffledOrder(prev, lower, random);
+    shuffledOrder(layer, upper, random);
+
+    std::uniform_int_distribution<int> degree(0, maxDegree);
+    std::uniform_int_distribution<int> target(0, qMax(0, lower - 1));
+    layer.offsets[0].resize(upper + 1);
+    layer.offsets[0][0] = 0;
+    layer.offsets[1].fill(0, upper + 1);
+    for (int v = 0; v < upper; v++) {
+        for (int d = lower > 0 ? degree(random) : 0; d > 0; d--) {
+            layer.adjacency[0].append(target(random));
+        }
+        layer.offsets[0][v + 1] = layer.adjacency[0].size();
+    }
+    layer.sorted[0].resize(layer.adjacency[0].size());
+    graph.sortNeighbors(1, 0);
+    return graph;
+}
+
+class TestCrossings : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void matchesPairwise_data();
+    void matchesPairwise();
+    void swapDiffMatchesRecount_data();
+    void swapDiffMatchesRecount();
+    void benchmark_data();
+    void benchmark();
+};
+
+void TestCrossings::matchesPairwise_data()
+{
+    QTest::addColumn<int>("upper");
+    QTest::addColumn<int>("lower");
+    QTest::addColumn<int>("maxDegree");
+
+    QTest::newRow("empty") << 0 << 0 << 0;
+    QTest::newRow("no edges") << 10 << 10 << 0;
+    QTest::newRow("one position") << 20 << 1 << 3;
+    QTest::newRow("single edges") << 50 << 50 << 1;
+    QTest::newRow("dense") << 30 << 10 << 8;
+    QTest::newRow("wide lower") << 40 << 500 << 4;
+    QTest::newRow("wide upper") << 500 << 40 << 2;
+}
+
+void TestCrossings::matchesPairwise()
+{
+    QFETCH(int, upper);
+    QFETCH(int, lower);
+    QFETCH(int, maxDegree);
+
+    std::mt19937 random(upper * 1000 + lower * 10 + maxDegree);
+    for (int i = 0; i < 100; i++) {
+        auto graph = randomBilayer(upper, lower, maxDegree, random);
+        auto &layer = graph.layers[1];
+        QCOMPARE(layer.crossings(0), pairwiseCrossings(layer, 0));
+        QCOMPARE(layer.crossings(1), 0LL);
+    }
+}
+
+void TestCrossings::swapDiffMatchesRecount_data()
+{
+    matchesPairwise_data();
+}
+
+// Swapping neighbours in the order only changes crossings between them
+void TestCrossings::swapDiffMatchesRecount()
+{
+    QFETCH(int, upper);
+    QFETCH(int, lower);
+    QFETCH(int, maxDegree);
+
+    if (upper < 2) {
+#if QT_VERSION >= QT_VERSION_CHECK(5,0,0)
+        QSKIP("Nothing to swap");
+#else
+        QSKIP("Nothing to swap", SkipSingle);
+#endif
+    }
+
+    std::mt19937 random(upper * 1000 + lower * 10 + maxDegree);
+    std::uniform_int_distribution<int> pickPosition(0, upper - 2);
+    for (int i = 0; i < 100; i++) {
+        auto graph = randomBilayer(upper, lower, maxDegree, random);
+        auto &layer = graph.layers[1];
+
+        int p = pickPosition(random);
+        int j = layer.order[p], n = layer.order[p + 1];
+        QVector<int> table(layer.positionCount(0));
+        layer.fillSwapTable(0, n, table);
+        int diff = layer.swapNodesDiff(0, j, table);
+
+        long long before = bruteForceCrossings(layer, 0);
+        qSwap(layer.order[p], layer.order[p + 1]);
+        long long after = bruteForceCrossings(layer, 0);
+        QCOMPARE(static_cast<long long>(diff), before - after);
+    }
+}
+
+void TestCrossings::benchmark_data()
+{
+    QTest::addColumn<bool>("tree");
+
+    QTest::newRow("accumulator tree") << true;
+    QTest::newRow("pairwise") << false;
+}
+
+// 10k dummy-like nodes with one or two edges each
+void TestCrossings::benchmark()
+{
+    QFETCH(bool, tree);
+
+    std::mt19937 random(1);
+    auto graph = randomBilayer(10000, 10000, 2, random);
+    auto &layer = graph.layers[1];
+
+    long long result = 0;
+    if (tree) {
+        QBENCHMARK {
+            result = layer.crossings(0);
+        }
+    } else {
+        QBENCHMARK {
+            result = pairwiseCrossings(layer, 0);
+        }
+    }
+    QVERIFY(result > 0);
+}
+
+QTEST_MAIN(TestCrossings)
+
+#include "tst_crossings.moc"
@@ -0,0 +1,16 @@
+QT       += core testlib
+QT       -= gui
+
+TARGET = tst_dateextractor
+CONFIG += console testcase
+CONFIG -= app_bundle
+TEMPLATE = app
+
+QMAKE_CXXFLAGS += -std=c++0x
+
+INCLUDEPATH += ../..
+
+SOURCES += tst_dateextractor.cpp \
+    ../../dateextractor.cpp
+
+HEADERS += ../../dateextractor.h
@@ -0,0 +1,118 @@
+#include <QtTest>
+#include <QRegExp>
+
+#include "dateextractor.h"
+
+// Dates as endpoints return them, with other digits around, none at all,
+// and digits outside ASCII: Arabic-Indic 1999 and fullwidth 2010
+static QStringList literals()
+{
+    return QStringList()
+            << "1999"
+            << "2001-05-03"
+            << "2001-05-03T10:20:30Z"
+            << "published 12345"
+            << "c. 1870?"
+            << "vol. 12, 1984, pp. 100-120"
+            << "no date"
+            << ""
+            << "123"
+            << QString::fromUtf8("\xd9\xa1\xd9\xa9\xd9\xa9\xd9\xa9")
+            << QString::fromUtf8("\xef\xbc\x92\xef\xbc\x90\xef\xbc\x91"
+                                 "\xef\xbc\x90")
+            << QString::fromUtf8("1984 \xd9\xa1\xd9\xa9\xd9\xa9\xd9\xa9")
+            << QString::fromUtf8("19\xd9\xa9\xd9\xa9 2003")
+            << QString::fromUtf8("\xef\xbc\x92\xef\xbc\x90\xef\xbc\x91"
+                                 "\xef\xbc\x90 1999-12");
+}
+
+class TestDateExtractor : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void matchesRegExp_data();
+    void matchesRegExp();
+    void memo_data();
+    void memo();
+
+private:
+    void addPatterns();
+};
+
+void TestDateExtractor::addPatterns()
+{
+    QTest::addColumn<QString>("pattern");
+
+    // Scanned
+    QTest::newRow("[0-9]{4}") << "[0-9]{4}";
+    QTest::newRow("[0-9] x4") << "[0-9][0-9][0-9][0-9]";
+    QTest::newRow("[0-9]{2}") << "[0-9]{2}";
+    // Regular expression
+    QTest::newRow("\\d{4}") << "\\d{4}";
+    QTest::newRow("\\d[0-9]{3}") << "\\d[0-9]{3}";
+    QTest::newRow("year-month") << "[0-9]{4}-[0-9]{2}";
+    QTest::newRow("century") << "(19|20)[0-9]{2}";
+}
+
+void TestDateExtractor::matchesRegExp_data()
+{
+    addPatterns();
+}
+
+// Same match as the last one QRegExp finds, the literal if none
+void TestDateExtractor::matchesRegExp()
+{
+    QFETCH(QString, pattern);
+
+    DateExtractor extractor(pattern);
+    foreach (auto literal, literals()) {
+        QRegExp re(pattern);
+        int idx = re.lastIndexIn(literal);
+        QString expected = idx >= 0 ? literal.mid(idx, re.matchedLength())
+                                    : literal;
+
+        QString date;
+        bool found = extractor.extract(literal, date);
+        QVERIFY2(found == (idx >= 0), qPrintable(literal));
+        QCOMPARE(date, expected);
+    }
+}
+
+void TestDateExtractor::memo_data()
+{
+    addPatterns();
+}
+
+// A repeated literal comes from the memo with the same result, misses
+// are counted every time
+void TestDateExtractor::memo()
+{
+    QFETCH(QString, pattern);
+
+    DateExtractor extractor(pattern);
+    auto all = literals();
+
+    QList<bool> found;
+    QStringList dates;
+    foreach (auto literal, all) {
+        QString date;
+        found.append(extractor.extract(literal, date));
+        dates.append(date);
+    }
+    QCOMPARE(extractor.memoHits(), qint64(0));
+    qint64 misses = extractor.misses();
+    QCOMPARE(misses, qint64(found.count(false)));
+
+    for (int i = 0; i < all.size(); i++) {
+        QString date;
+        QCOMPARE(extractor.extract(all[i], date), found[i]);
+        QCOMPARE(date, dates[i]);
+    }
+    QCOMPARE(extractor.memoHits(), qint64(all.size()));
+    QCOMPARE(extractor.misses(), 2 * misses);
+}
+
+QTEST_MAIN(TestDateExtractor)
+
+#include "tst_dateextractor.moc"
@@ -0,0 +1,50 @@
+QT       += core network xml
+
+greaterThan(QT_MAJOR_VERSION, 4): DEFINES += "QT_DISABLE_DEPRECATED_BEFORE=0"
+
+TARGET = loadtest
+CONFIG += console
+CONFIG -= app_bundle
+TEMPLATE = app
+
+QMAKE_CXXFLAGS += -std=c++0x
+
+LIBS += -lz
+
+INCLUDEPATH += ../..
+
+SOURCES += main.cpp \
+    mockendpoint.cpp \
+    ../../dataset.cpp \
+    ../../sparqlquery.cpp \
+    ../../sparqlqueryinfo.cpp \
+    ../../sparqltokenizer.cpp \
+    ../../sparqlresultsparser.cpp \
+    ../../publicationdiskcache.cpp \
+    ../../propertyassembler.cpp \
+    ../../dateextractor.cpp \
+    ../../rdffileloader.cpp \
+    ../../turtleparser.cpp \
+    ../../workerthread.cpp \
+    ../../concurrencycontroller.cpp \
+    ../../querystatistics.cpp \
+    ../../decompressor.cpp \
+    ../../identifier.cpp
+
+HEADERS += mockendpoint.h \
+    ../../dataset.h \
+    ../../sparqlquery.h \
+    ../../sparqlqueryinfo.h \
+    ../../sparqltokenizer.h \
+    ../../sparqlresultsparser.h \
+    ../../publicationdiskcache.h \
+    ../../propertyassembler.h \
+    ../../dateextractor.h \
+    ../../rdffileloader.h \
+    ../../turtleparser.h \
+    ../../workerthread.h \
+    ../../concurrencycontroller.h \
+    ../../querystatistics.h \
+    ../../decompressor.h \
+    ../../identifier.h \
+    ../../publication.h
@@ -0,0 +1,142 @@
+#include <QCoreApplication>
+#include <QEventLoop>
+#include <QStringList>
+#include <QTextStream>
+
+#ifdef Q_OS_UNIX
+#   include <sys/resource.h>
+#endif
+
+#include "mockendpoint.h"
+#include "dataset.h"
+#include "publicationdiskcache.h"
+
+static const char *const usage =
+        "Usage: loadtest [options]\n"
+        "Loads a dataset from a local mock endpoint and reports the cost.\n"
+        "  --publications N   publications in the generated graph (1000)\n"
+        "  --references N     most references per publication (8)\n"
+        "  --latency MS       delay before each response (0)\n"
+        "  --bandwidth B      bytes per second over all connections, 0 for\n"
+        "                     unlimited (0)\n"
+        "  --errors RATE      share of property queries failing (0)\n"
+        "  --format F         json, xml, tsv or csv (json)\n"
+        "  --values           property queries with VALUES, not FILTER\n"
+        "  --no-recursive     don't load referenced publications\n"
+        "  --runs N           loads one after another (1)\n"
+        "  --seed N           seed of the graph and the failures (1)\n";
+
+static const char *const mainQuery =
+        "PREFIX akt:<http://www.aktors.org/ontology/portal#>\n"
+        "SELECT ?publication WHERE { ?publication akt:has-title ?title }";
+
+// Peak resident memory of the process in KiB, the endpoint included
+static long peakMemory()
+{
+#ifdef Q_OS_UNIX
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) == 0) {
+#   ifdef Q_OS_MAC
+        return usage.ru_maxrss / 1024;
+#   else
+        return usage.ru_maxrss;
+#   endif
+    }
+#endif
+    return -1;
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    // Keeps the disk cache apart from the application's
+    app.setApplicationName("citnetvis2-loadtest");
+
+    QTextStream out(stdout), err(stderr);
+
+    MockEndpoint::Options options;
+    bool useValues = false, recursive = true;
+    int runs = 1;
+
+    auto args = app.arguments();
+    for (int i = 1; i < args.size(); i++) {
+        const QString &arg = args[i];
+        if (arg == "--values") {
+            useValues = true;
+            continue;
+        }
+        if (arg == "--no-recursive") {
+            recursive = false;
+            continue;
+        }
+
+        QString value = i + 1 < args.size() ? args[++i] : QString();
+        bool ok = false;
+        if (arg == "--publications") {
+            options.publications = value.toInt(&ok);
+            ok = ok && options.publications > 0;
+        } else if (arg == "--references") {
+            options.maxReferences = value.toInt(&ok);
+        } else if (arg == "--latency") {
+            options.latency = value.toInt(&ok);
+        } else if (arg == "--bandwidth") {
+            options.bandwidth = value.toLongLong(&ok);
+        } else if (arg == "--errors") {
+            options.errorRate = value.toDouble(&ok);
+        } else if (arg == "--format") {
+            int format = (QStringList() << "xml" << "json" << "tsv" << "csv")
+                    .indexOf(value);
+            options.format = static_cast<SparqlResultsParser::Format>(format);
+            ok = format >= 0;
+        } else if (arg == "--runs") {
+            runs = value.toInt(&ok);
+        } else if (arg == "--seed") {
+            options.seed = value.toUInt(&ok);
+        }
+        if (!ok) {
+            err << usage;
+            return 1;
+        }
+    }
+
+    MockEndpoint endpoint(options);
+    if (!endpoint.listen()) {
+        err << "Can't listen on localhost\n";
+        return 1;
+    }
+
+    // Every run fetches everything, nothing comes from the caches
+    Dataset::setCacheBudget(0);
+    PublicationDiskCache::instance()->setMaxAge(0);
+
+    for (int run = 1; run <= runs; run++) {
+        int requests = endpoint.requestCount();
+        int failures = endpoint.failedCount();
+        qint64 sent = endpoint.bytesSent();
+
+        Dataset dataset(endpoint.url(), mainQuery, "akt:has-date",
+                        "akt:has-title", "akt:cites-publication-reference",
+                        "[0-9]{4}", recursive, useValues);
+        QEventLoop loop;
+        QObject::connect(&dataset, SIGNAL(finished()), &loop, SLOT(quit()));
+        loop.exec();
+
+        out << "run " << run << ": "
+            << dataset.publications().size() << " publications, "
+            << dataset.failedPublications().size() << " failed, "
+            << dataset.queryCount() << " queries, "
+            << endpoint.requestCount() - requests << " requests ("
+            << endpoint.failedCount() - failures << " failed), "
+            << endpoint.bytesSent() - sent << " bytes sent, "
+            << dataset.compressedBytes() << " received, "
+            << dataset.uncompressedBytes() << " decoded, "
+            << dataset.loadTime() << " ms\n";
+        if (dataset.hasError()) {
+            out << "  error: " << dataset.errorString() << "\n";
+        }
+        out.flush();
+    }
+
+    out << "peak memory: " << peakMemory() << " KiB\n";
+    return 0;
+}
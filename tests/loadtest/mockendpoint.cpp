@@ -0,0 +1,352 @@
+#include "mockendpoint.h"
+
+#include <QXmlStreamWriter>
+#include <QRegExp>
+#include <QSet>
+
+const char *const MockEndpoint::titlePredicate =
+        "http://www.aktors.org/ontology/portal#has-title";
+const char *const MockEndpoint::datePredicate =
+        "http://www.aktors.org/ontology/portal#has-date";
+const char *const MockEndpoint::referencePredicate =
+        "http://www.aktors.org/ontology/portal#cites-publication-reference";
+
+// Delayed and throttled responses are written in slices this often
+static const int pumpInterval = 10;
+
+static const char *const contentTypes[] = {
+    "application/sparql-results+xml",
+    "application/sparql-results+json",
+    "text/tab-separated-values",
+    "text/csv"
+};
+
+MockEndpoint::MockEndpoint(const Options &options, QObject *parent)
+    : QObject(parent), options(options), random(options.seed), requests(0),
+      failures(0), sent(0)
+{
+    connect(&server, SIGNAL(newConnection()), SLOT(acceptConnection()));
+    pumpTimer.setInterval(pumpInterval);
+    connect(&pumpTimer, SIGNAL(timeout()), SLOT(pump()));
+    clock.start();
+    generate();
+}
+
+bool MockEndpoint::listen()
+{
+    return server.listen(QHostAddress::LocalHost);
+}
+
+QUrl MockEndpoint::url() const
+{
+    return QUrl(QString("http://127.0.0.1:%1/sparql")
+                .arg(server.serverPort()));
+}
+
+// Publications only cite older ones, dates rise with the number
+void MockEndpoint::generate()
+{
+    std::uniform_int_distribution<int> referenceCount(0,
+                                                      options.maxReferences);
+    std::uniform_int_distribution<int> month(1, 12);
+
+    for (int n = 0; n < options.publications; n++) {
+        auto iri = QString("http://example.org/publication/%1").arg(n);
+        publicationIris.append(iri);
+
+        int year = 1960 + 50 * n / options.publications;
+        addTriple(iri, titlePredicate, QString("Publication %1").arg(n),
+                  false);
+        addTriple(iri, datePredicate, QString("%1-%2-01").arg(year)
+                  .arg(month(random), 2, 10, QChar('0')), false);
+        if (n > 0) {
+            std::uniform_int_distribution<int> cited(0, n - 1);
+            for (int k = referenceCount(random); k > 0; k--) {
+                addTriple(iri, referencePredicate,
+                          publicationIris[cited(random)], true);
+            }
+        }
+    }
+}
+
+void MockEndpoint::addTriple(const QString &s, const char *p,
+                             const QString &o, bool iri)
+{
+    Term predicate = { QString::fromLatin1(p), true };
+    Term object = { o, iri };
+    triples[s] << predicate << object;
+}
+
+void MockEndpoint::acceptConnection()
+{
+    while (server.hasPendingConnections()) {
+        auto socket = server.nextPendingConnection();
+        clients.insert(socket, Client());
+        connect(socket, SIGNAL(readyRead()), SLOT(readRequest()));
+        connect(socket, SIGNAL(disconnected()), SLOT(clientDisconnected()));
+    }
+}
+
+void MockEndpoint::clientDisconnected()
+{
+    auto socket = static_cast<QTcpSocket*>(sender());
+    clients.remove(socket);
+    socket->deleteLater();
+}
+
+// One request at a time per connection, the next one is answered when
+// the response is written
+void MockEndpoint::readRequest()
+{
+    auto found = clients.find(static_cast<QTcpSocket*>(sender()));
+    if (found == clients.end()) {
+        return;
+    }
+
+    found->request.append(found.key()->readAll());
+    QByteArray body;
+    if (found->response.isEmpty() && takeRequest(*found, body)) {
+        answer(*found, body);
+        if (!pumpTimer.isActive()) {
+            pump();
+        }
+    }
+}
+
+// Removes the first complete request from the buffer, keeps the body
+bool MockEndpoint::takeRequest(Client &client, QByteArray &body)
+{
+    int end = client.request.indexOf("\r\n\r\n");
+    if (end < 0) {
+        return false;
+    }
+
+    int length = 0;
+    foreach (auto line, client.request.left(end).split('\n')) {
+        int colon = line.indexOf(':');
+        if (colon > 0 &&
+                line.left(colon).trimmed().toLower() == "content-length")
+        {
+            length = line.mid(colon + 1).trimmed().toInt();
+        }
+    }
+
+    int size = end + 4 + length;
+    if (client.request.size() < size) {
+        return false;
+    }
+    body = client.request.mid(end + 4, length);
+    client.request.remove(0, size);
+    return true;
+}
+
+void MockEndpoint::answer(Client &client, const QByteArray &body)
+{
+    requests++;
+
+    QString query;
+    foreach (auto field, body.split('&')) {
+        if (field.startsWith("query=")) {
+            query = QUrl::fromPercentEncoding(field.mid(6).replace('+', ' '));
+        }
+    }
+
+    QByteArray status = "200 OK", content;
+    std::uniform_real_distribution<double> chance(0, 1);
+    if (!query.contains("?s ?p ?o")) {
+        QVector<Term> values;
+        foreach (auto i, publicationIris) {
+            Term publication = { i, true };
+            values.append(publication);
+        }
+        content = serialize(QStringList() << "publication", values);
+    } else if (chance(random) < options.errorRate) {
+        failures++;
+        status = "503 Service Unavailable";
+    } else {
+        // Subjects are the publications among the query's IRIs
+        QSet<QString> predicates;
+        foreach (auto i, QStringList() << titlePredicate << datePredicate
+                 << referencePredicate)
+        {
+            if (query.contains("<" + i + ">")) {
+                predicates.insert(i);
+            }
+        }
+
+        QSet<QString> subjects;
+        QVector<Term> values;
+        QRegExp iri("<([^>]*)>");
+        for (int pos = 0; (pos = iri.indexIn(query, pos)) >= 0;
+             pos += iri.matchedLength())
+        {
+            auto s = iri.cap(1);
+            auto found = triples.constFind(s);
+            if (found == triples.constEnd() || subjects.contains(s)) {
+                continue;
+            }
+            subjects.insert(s);
+
+            Term subject = { s, true };
+            for (int k = 0; k < found->size(); k += 2) {
+                if (predicates.contains(found->at(k).value)) {
+                    values << subject << found->at(k) << found->at(k + 1);
+                }
+            }
+        }
+        content = serialize(QStringList() << "s" << "p" << "o", values);
+    }
+
+    client.response = "HTTP/1.1 " + status + "\r\n";
+    if (!content.isEmpty()) {
+        client.response += "Content-Type: ";
+        client.response += contentTypes[options.format];
+        client.response += "; charset=utf-8\r\n";
+    }
+    client.response += "Content-Length: " +
+            QByteArray::number(content.size()) + "\r\n\r\n";
+    client.response += content;
+    client.written = 0;
+    client.due = clock.elapsed() + options.latency;
+}
+
+static QByteArray jsonString(const QString &s)
+{
+    QString escaped = s;
+    escaped.replace('\\', "\\\\").replace('"', "\\\"");
+    return "\"" + escaped.toUtf8() + "\"";
+}
+
+static QByteArray delimitedField(const QString &s)
+{
+    if (!s.contains(',') && !s.contains('"') && !s.contains('\n')) {
+        return s.toUtf8();
+    }
+    QString escaped = s;
+    escaped.replace('"', "\"\"");
+    return "\"" + escaped.toUtf8() + "\"";
+}
+
+QByteArray MockEndpoint::serialize(const QStringList &vars,
+                                   const QVector<Term> &values) const
+{
+    int columns = vars.size();
+    QByteArray out;
+
+    switch (options.format) {
+    case SparqlResultsParser::Xml: {
+        QXmlStreamWriter xml(&out);
+        xml.writeStartDocument();
+        xml.writeStartElement("sparql");
+        xml.writeDefaultNamespace("http://www.w3.org/2005/sparql-results#");
+        xml.writeStartElement("head");
+        foreach (auto v, vars) {
+            xml.writeEmptyElement("variable");
+            xml.writeAttribute("name", v);
+        }
+        xml.writeEndElement();
+        xml.writeStartElement("results");
+        for (int i = 0; i < values.size(); i += columns) {
+            xml.writeStartElement("result");
+            for (int c = 0; c < columns; c++) {
+                auto &t = values[i + c];
+                xml.writeStartElement("binding");
+                xml.writeAttribute("name", vars[c]);
+                xml.writeTextElement(t.iri ? "uri" : "literal", t.value);
+                xml.writeEndElement();
+            }
+            xml.writeEndElement();
+        }
+        xml.writeEndDocument();
+        break;
+    }
+    case SparqlResultsParser::Json:
+        out += "{\"head\":{\"vars\":[";
+        for (int c = 0; c < columns; c++) {
+            out += (c ? "," : "") + jsonString(vars[c]);
+        }
+        out += "]},\"results\":{\"bindings\":[";
+        for (int i = 0; i < values.size(); i += columns) {
+            out += i ? ",\n{" : "\n{";
+            for (int c = 0; c < columns; c++) {
+                auto &t = values[i + c];
+                out += (c ? "," : "") + jsonString(vars[c]);
+                out += t.iri ? ":{\"type\":\"uri\",\"value\":"
+                             : ":{\"type\":\"literal\",\"value\":";
+                out += jsonString(t.value) + "}";
+            }
+            out += "}";
+        }
+        out += "]}}\n";
+        break;
+    case SparqlResultsParser::Tsv:
+        out += "?" + vars.join("\t?").toUtf8() + "\n";
+        for (int i = 0; i < values.size(); i += columns) {
+            for (int c = 0; c < columns; c++) {
+                auto &t = values[i + c];
+                out += c ? "\t" : "";
+                out += t.iri ? "<" + t.value.toUtf8() + ">"
+                             : jsonString(t.value);
+            }
+            out += "\n";
+        }
+        break;
+    case SparqlResultsParser::Csv:
+        out += vars.join(",").toUtf8() + "\r\n";
+        for (int i = 0; i < values.size(); i += columns) {
+            for (int c = 0; c < columns; c++) {
+                out += c ? "," : "";
+                out += delimitedField(values[i + c].value);
+            }
+            out += "\r\n";
+        }
+        break;
+    }
+    return out;
+}
+
+// Ready responses share the bandwidth evenly
+void MockEndpoint::pump()
+{
+    qint64 now = clock.elapsed();
+    int ready = 0;
+    for (auto i = clients.constBegin(); i != clients.constEnd(); ++i) {
+        if (!i->response.isEmpty() && i->due <= now) {
+            ready++;
+        }
+    }
+    qint64 share = -1;
+    if (options.bandwidth > 0 && ready > 0) {
+        share = qMax<qint64>(1, options.bandwidth * pumpInterval / 1000
+                             / ready);
+    }
+
+    bool pending = false;
+    for (auto i = clients.begin(); i != clients.end(); ++i) {
+        auto &client = i.value();
+        if (!client.response.isEmpty() && client.due <= now) {
+            qint64 n = client.response.size() - client.written;
+            if (share >= 0) {
+                n = qMin(n, share);
+            }
+            i.key()->write(client.response.constData() + client.written, n);
+            client.written += n;
+            sent += n;
+
+            QByteArray body;
+            if (client.written == client.response.size()) {
+                client.response.clear();
+                if (takeRequest(client, body)) {
+                    answer(client, body);
+                }
+            }
+        }
+        pending = pending || !client.response.isEmpty();
+    }
+
+    if (!pending) {
+        pumpTimer.stop();
+    } else if (!pumpTimer.isActive()) {
+        pumpTimer.start();
+    }
+}
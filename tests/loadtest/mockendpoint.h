@@ -0,0 +1,101 @@
+#ifndef MOCKENDPOINT_H
+#define MOCKENDPOINT_H
+
+#include <QTcpServer>
+#include <QTcpSocket>
+#include <QHash>
+#include <QStringList>
+#include <QElapsedTimer>
+#include <QTimer>
+#include <QUrl>
+
+#include <random>
+
+#include "sparqlresultsparser.h"
+
+// SPARQL endpoint on localhost for load tests. A citation graph is
+// generated in memory; Dataset's property queries (?s ?p ?o for a list of
+// subjects) are answered from it and any other query gets the list of all
+// publications. Responses can be delayed, throttled and failed.
+class MockEndpoint : public QObject
+{
+    Q_OBJECT
+public:
+    struct Options
+    {
+        Options()
+            : publications(1000), maxReferences(8), latency(0),
+              bandwidth(0), errorRate(0), format(SparqlResultsParser::Json),
+              seed(1) { }
+
+        int publications, maxReferences;
+        // Milliseconds before a response starts, bytes per second or 0
+        int latency;
+        qint64 bandwidth;
+        // Share of property queries answered with 503
+        double errorRate;
+        SparqlResultsParser::Format format;
+        quint32 seed;
+    };
+
+    static const char *const titlePredicate;
+    static const char *const datePredicate;
+    static const char *const referencePredicate;
+
+    explicit MockEndpoint(const Options &, QObject *parent = 0);
+
+    bool listen();
+    QUrl url() const;
+
+    // Totals since construction, headers included in bytes
+    int requestCount() const { return requests; }
+    int failedCount() const { return failures; }
+    qint64 bytesSent() const { return sent; }
+
+private slots:
+    void acceptConnection();
+    void readRequest();
+    void clientDisconnected();
+    void pump();
+
+private:
+    struct Term
+    {
+        QString value;
+        bool iri;
+    };
+
+    struct Client
+    {
+        Client() : written(0), due(0) { }
+
+        QByteArray request;
+        QByteArray response;
+        int written;
+        qint64 due;
+    };
+
+    void generate();
+    void addTriple(const QString &s, const char *p, const QString &o,
+                   bool iri);
+    bool takeRequest(Client &, QByteArray &body);
+    void answer(Client &, const QByteArray &body);
+    QByteArray serialize(const QStringList &vars,
+                         const QVector<Term> &values) const;
+
+    Options options;
+    QTcpServer server;
+    QHash<QTcpSocket*, Client> clients;
+    QTimer pumpTimer;
+    QElapsedTimer clock;
+    std::mt19937 random;
+
+    QStringList publicationIris;
+    // ?p ?o of every subject, two terms per triple
+    QHash<QString, QVector<Term> > triples;
+
+    int requests, failures;
+    qint64 sent;
+};
+
+#endif // MOCKENDPOINT_H
@@ -0,0 +1,33 @@
+QT       += core network xml testlib
+QT       -= gui
+
+TARGET = tst_rdffileloader
+CONFIG += console testcase
+CONFIG -= app_bundle
+TEMPLATE = app
+
+QMAKE_CXXFLAGS += -std=c++0x
+
+LIBS += -lz
+
+INCLUDEPATH += ../..
+
+RESOURCES += rdffileloader.qrc
+
+SOURCES += tst_rdffileloader.cpp \
+    ../../turtleparser.cpp \
+    ../../rdffileloader.cpp \
+    ../../sparqlresultsparser.cpp \
+    ../../propertyassembler.cpp \
+    ../../dateextractor.cpp \
+    ../../decompressor.cpp \
+    ../../identifier.cpp
+
+HEADERS += ../../turtleparser.h \
+    ../../rdffileloader.h \
+    ../../sparqlresultsparser.h \
+    ../../propertyassembler.h \
+    ../../dateextractor.h \
+    ../../decompressor.h \
+    ../../identifier.h \
+    ../../publication.h
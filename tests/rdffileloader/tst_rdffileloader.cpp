@@ -0,0 +1,344 @@
+#include <QtTest>
+#include <QFile>
+#include <QDir>
+#include <QTemporaryFile>
+
+#include "turtleparser.h"
+#include "rdffileloader.h"
+#include "sparqlresultsparser.h"
+#include "propertyassembler.h"
+
+static const char *const akt = "http://www.aktors.org/ontology/portal#";
+static const char *const rdfType =
+        "http://www.w3.org/1999/02/22-rdf-syntax-ns#type";
+static const char *const prefixE = "@prefix e: <http://e/> .\n";
+
+// Feeds the data in chunks of the given size, so every token gets split
+static SparqlQuery::Results parseTurtle(const QByteArray &data, int chunk,
+                                        QString *error)
+{
+    TurtleParser parser(QSet<QString>() << "http://e/p" << rdfType);
+    for (int pos = 0; pos < data.size(); pos += chunk) {
+        parser.addData(data.mid(pos, chunk));
+    }
+    parser.finish();
+    if (parser.hasError()) {
+        *error = parser.errorString();
+    }
+    return parser.takeResults();
+}
+
+static QByteArray resource(const QString &name)
+{
+    QFile file(name);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return QByteArray();
+    }
+    return file.readAll();
+}
+
+// Publications assembled from ?s ?p ?o rows and merged like Dataset does
+class Receiver : public QObject
+{
+    Q_OBJECT
+public:
+    Receiver()
+        : assembler(QString("<%1has-date>").arg(akt),
+                    QString("<%1has-title>").arg(akt),
+                    QString("<%1cites-publication-reference>").arg(akt),
+                    QRegExp("[0-9]{4}")),
+          end(false)
+    {
+        connect(&assembler,
+                SIGNAL(assembled(QList<Publication>,int,QString)),
+                SLOT(assembled(QList<Publication>,int,QString)));
+    }
+
+    PropertyAssembler assembler;
+    QHash<Identifier, Publication> publications;
+    QString error;
+    bool end;
+
+public slots:
+    void triples(const SparqlQuery::Results &results, bool last,
+                 const QString &err)
+    {
+        end = last;
+        if (!err.isEmpty()) {
+            error = err;
+            return;
+        }
+        assembler.addProperties(results);
+    }
+
+    void assembled(const QList<Publication> &batch, int, const QString &err)
+    {
+        if (!err.isEmpty()) {
+            error = err;
+        }
+        foreach (auto p, batch) {
+            auto j = publications.find(p.iri());
+            if (j == publications.end()) {
+                j = publications.insert(p.iri(), Publication(p.iri()));
+            }
+            if (!p.title.isEmpty()) {
+                j->title = p.title;
+            }
+            j->dates.unite(p.dates);
+            j->references.unite(p.references);
+        }
+    }
+};
+
+// Reads a dump to the end through RdfFileLoader
+static void load(const QString &fileName, Receiver &receiver)
+{
+    QSet<QString> predicates;
+    foreach (auto i, QStringList() << "has-date" << "has-title"
+             << "cites-publication-reference")
+    {
+        predicates.insert(akt + i);
+    }
+
+    RdfFileLoader loader(fileName, predicates);
+    QObject::connect(&loader,
+                     SIGNAL(triples(SparqlQuery::Results,bool,QString)),
+                     &receiver,
+                     SLOT(triples(SparqlQuery::Results,bool,QString)));
+    while (!receiver.end) {
+        loader.readChunk();
+    }
+}
+
+class TestRdfFileLoader : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void chunkBoundaries_data();
+    void chunkBoundaries();
+    void errors_data();
+    void errors();
+    void dumpMatchesResults_data();
+    void dumpMatchesResults();
+    void truncatedGzip();
+};
+
+void TestRdfFileLoader::chunkBoundaries_data()
+{
+    QTest::addColumn<QByteArray>("data");
+    // ?s ?p ?o of the triples with e:p or rdf:type, row after row
+    QTest::addColumn<QStringList>("triples");
+
+    QTest::newRow("iris")
+            << QByteArray("<http://e/s> <http://e/p> <http://e/o> .\n"
+                          "<http://e/s> <http://e/q> <http://e/o> .\n"
+                          "<http://e/s2> <http://e/p> <http://e/o2> .")
+            << (QStringList() << "http://e/s" << "http://e/p" << "http://e/o"
+                << "http://e/s2" << "http://e/p" << "http://e/o2");
+
+    QTest::newRow("utf-8")
+            << QByteArray("<http://e/\xc3\xb6> <http://e/p> "
+                          "\"\xc3\x9c" "bergr\xc3\xb6\xc3\x9f" "e \\u00e9\" .")
+            << (QStringList() << QString::fromUtf8("http://e/\xc3\xb6")
+                << "http://e/p"
+                << QString::fromUtf8("\xc3\x9c" "bergr\xc3\xb6\xc3\x9f"
+                                     "e \xc3\xa9"));
+
+    QTest::newRow("long strings")
+            << QByteArray("<http://e/s> <http://e/p> \"\"\"two\nlines with "
+                          "\"one\" and \"\"two\"\" quotes\"\"\" .\n"
+                          "<http://e/s> <http://e/p> '''it's'''.\n"
+                          "<http://e/s> <http://e/p> "
+                          "\"\"\"ends in \"\"quotes\"\"\"\"\" .\n")
+            << (QStringList()
+                << "http://e/s" << "http://e/p"
+                << "two\nlines with \"one\" and \"\"two\"\" quotes"
+                << "http://e/s" << "http://e/p" << "it's"
+                << "http://e/s" << "http://e/p" << "ends in \"\"quotes\"\"");
+
+    QTest::newRow("trailing dots")
+            << (QByteArray(prefixE) + "e:s e:p e:o1.\n"
+                "e:s e:p 42.\n"
+                "e:s e:p e:o.2 .\n"
+                "e:s e:p e:o3.")
+            << (QStringList() << "http://e/s" << "http://e/p" << "http://e/o1"
+                << "http://e/s" << "http://e/p" << "42"
+                << "http://e/s" << "http://e/p" << "http://e/o.2"
+                << "http://e/s" << "http://e/p" << "http://e/o3");
+
+    QTest::newRow("directives")
+            << QByteArray("@prefix e: <http://e/> .\n"
+                          "PREFIX f: <http://f/>\n"
+                          "prefix g: <http://g/>\n"
+                          "@base <http://e/sub/> .\n"
+                          "e:s <../p> f:o .\n"
+                          "BASE <http://g/>\n"
+                          "<s> e:p <o> .\n"
+                          "g:s e:p g:o .")
+            << (QStringList() << "http://e/s" << "http://e/p" << "http://f/o"
+                << "http://g/s" << "http://e/p" << "http://g/o"
+                << "http://g/s" << "http://e/p" << "http://g/o");
+
+    QTest::newRow("nested blank nodes")
+            << (QByteArray(prefixE) +
+                "e:s e:p [ e:p [ e:p e:o ] ; e:q 1 ], e:o2 .\n"
+                "[ e:p e:o3 ] .\n"
+                "[] e:p e:o4 .")
+            << (QStringList() << "http://e/s" << "http://e/p" << "_:node1"
+                << "_:node1" << "http://e/p" << "_:node2"
+                << "_:node2" << "http://e/p" << "http://e/o"
+                << "http://e/s" << "http://e/p" << "http://e/o2"
+                << "_:node3" << "http://e/p" << "http://e/o3"
+                << "_:node4" << "http://e/p" << "http://e/o4");
+
+    QTest::newRow("collections")
+            << (QByteArray(prefixE) +
+                "e:s e:p ( e:a ( e:b \"c\" ) [ e:p e:d ] ), e:o .\n"
+                "( e:x ) e:p e:y .")
+            << (QStringList() << "http://e/s" << "http://e/p" << "_:node1"
+                << "http://e/s" << "http://e/p" << "http://e/o"
+                << "_:node2" << "http://e/p" << "http://e/y");
+
+    QTest::newRow("a")
+            << (QByteArray(prefixE) + "e:s a e:T ; e:p e:o ;\n"
+                "    e:q e:r .")
+            << (QStringList() << "http://e/s" << rdfType << "http://e/T"
+                << "http://e/s" << "http://e/p" << "http://e/o");
+
+    QTest::newRow("languages and datatypes")
+            << (QByteArray(prefixE) +
+                "@prefix xsd: <http://www.w3.org/2001/XMLSchema#> .\n"
+                "e:s e:p \"chat\"@fr, 'chat'@en-GB, \"1\"^^xsd:integer,\n"
+                "    \"2\"^^<http://www.w3.org/2001/XMLSchema#integer>, 3,\n"
+                "    true .")
+            << (QStringList() << "http://e/s" << "http://e/p" << "chat"
+                << "http://e/s" << "http://e/p" << "chat"
+                << "http://e/s" << "http://e/p" << "1"
+                << "http://e/s" << "http://e/p" << "2"
+                << "http://e/s" << "http://e/p" << "3"
+                << "http://e/s" << "http://e/p" << "true");
+
+    QTest::newRow("comments")
+            << (QByteArray("# <http://e/x> <http://e/p> <http://e/y> .\n") +
+                prefixE + "e:s e:p e:o . # e:s e:p e:z .\n"
+                "<http://e/s#1> e:p \"#\" .")
+            << (QStringList() << "http://e/s" << "http://e/p" << "http://e/o"
+                << "http://e/s#1" << "http://e/p" << "#");
+}
+
+// Every chunk size must give the same triples as parsing in one go
+void TestRdfFileLoader::chunkBoundaries()
+{
+    QFETCH(QByteArray, data);
+    QFETCH(QStringList, triples);
+
+    QString error;
+    auto whole = parseTurtle(data, data.size(), &error);
+    QVERIFY2(error.isEmpty(), qPrintable(error));
+    QCOMPARE(whole.variables, QStringList() << "s" << "p" << "o");
+    QCOMPARE(QStringList(QList<QString>::fromVector(whole.values)), triples);
+
+    for (int chunk = 1; chunk < data.size(); chunk++) {
+        auto results = parseTurtle(data, chunk, &error);
+        QVERIFY2(error.isEmpty(),
+                 qPrintable(QString("chunk %1: %2").arg(chunk).arg(error)));
+        QVERIFY2(results.values == whole.values,
+                 qPrintable(QString("chunk %1").arg(chunk)));
+    }
+}
+
+void TestRdfFileLoader::errors_data()
+{
+    QTest::addColumn<QByteArray>("data");
+
+    QTest::newRow("unterminated iri") << QByteArray("<http://e/s> <http://e/p");
+    QTest::newRow("unterminated string")
+            << QByteArray("<http://e/s> <http://e/p> \"abc .\n");
+    QTest::newRow("unterminated long string")
+            << QByteArray("<http://e/s> <http://e/p> \"\"\"abc\"\" .\n");
+    QTest::newRow("undefined prefix") << QByteArray("e:s e:p e:o .");
+    QTest::newRow("missing dot")
+            << QByteArray("<http://e/s> <http://e/p> <http://e/o>");
+    QTest::newRow("unclosed blank node")
+            << (QByteArray(prefixE) + "e:s e:p [ e:p e:o .");
+    QTest::newRow("unclosed collection")
+            << (QByteArray(prefixE) + "e:s e:p ( e:o .");
+    QTest::newRow("literal subject")
+            << QByteArray("\"s\" <http://e/p> <http://e/o> .");
+}
+
+void TestRdfFileLoader::errors()
+{
+    QFETCH(QByteArray, data);
+
+    for (int chunk = 1; chunk <= data.size(); chunk++) {
+        QString error;
+        parseTurtle(data, chunk, &error);
+        QVERIFY2(!error.isEmpty(), qPrintable(QString("chunk %1")
+                                              .arg(chunk)));
+    }
+}
+
+void TestRdfFileLoader::dumpMatchesResults_data()
+{
+    QTest::addColumn<QString>("fileName");
+
+    // The resultsparser fixture written out as N-Triples, and as Turtle
+    // using most of the syntax, gzipped in two members
+    QTest::newRow("n-triples") << QString(":/data/properties.nt");
+    QTest::newRow("turtle gzip") << QString(":/data/properties.ttl.gz");
+}
+
+// A dump of the same triples must give what property queries give
+void TestRdfFileLoader::dumpMatchesResults()
+{
+    QFETCH(QString, fileName);
+
+    QScopedPointer<SparqlResultsParser> parser(
+                SparqlResultsParser::create(SparqlResultsParser::Json));
+    parser->addData(resource(":/data/properties.srj"));
+    parser->finish();
+    QVERIFY2(!parser->hasError(), qPrintable(parser->errorString()));
+    Receiver expected;
+    expected.assembler.addProperties(parser->takeResults());
+    QVERIFY2(expected.error.isEmpty(), qPrintable(expected.error));
+    QVERIFY(expected.publications.size() > 100);
+
+    Receiver dump;
+    load(fileName, dump);
+    QVERIFY2(dump.error.isEmpty(), qPrintable(dump.error));
+    QCOMPARE(dump.publications.size(), expected.publications.size());
+
+    foreach (auto e, expected.publications) {
+        auto found = dump.publications.constFind(e.iri());
+        QVERIFY2(found != dump.publications.constEnd(),
+                 qPrintable(e.iri().toString()));
+        QCOMPARE(found->title, e.title);
+        QVERIFY2(found->dates == e.dates, qPrintable(e.iri().toString()));
+        QVERIFY2(found->references == e.references,
+                 qPrintable(e.iri().toString()));
+        // Row order differs between the files
+        QCOMPARE(found->digest, e.digest);
+    }
+}
+
+// A gzip file cut short is an error, not a shorter dump
+void TestRdfFileLoader::truncatedGzip()
+{
+    auto data = resource(":/data/properties.ttl.gz");
+    QVERIFY(!data.isEmpty());
+
+    QTemporaryFile file(QDir::tempPath() + "/XXXXXX.ttl.gz");
+    QVERIFY(file.open());
+    file.write(data.left(data.size() - 4));
+    file.close();
+
+    Receiver receiver;
+    load(file.fileName(), receiver);
+    QVERIFY(receiver.error.contains("truncated"));
+}
+
+QTEST_MAIN(TestRdfFileLoader)
+
+#include "tst_rdffileloader.moc"
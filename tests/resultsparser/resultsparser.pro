@@ -0,0 +1,22 @@
+QT       += core network xml testlib
+QT       -= gui
+
+TARGET = tst_resultsparser
+CONFIG += console testcase
+CONFIG -= app_bundle
+TEMPLATE = app
+
+QMAKE_CXXFLAGS += -std=c++0x
+
+LIBS += -lz
+
+INCLUDEPATH += ../..
+
+RESOURCES += resultsparser.qrc
+
+SOURCES += tst_resultsparser.cpp \
+    ../../sparqlresultsparser.cpp \
+    ../../decompressor.cpp
+
+HEADERS += ../../sparqlresultsparser.h \
+    ../../decompressor.h
@@ -0,0 +1,118 @@
+#include <QtTest>
+#include <QFile>
+
+#include "sparqlresultsparser.h"
+
+Q_DECLARE_METATYPE(SparqlResultsParser::Format)
+
+// The same property response (?s ?p ?o rows of titles, dates and
+// references, shaped like ACM RKB answers) recorded in every format
+static QByteArray fixture(SparqlResultsParser::Format format)
+{
+    static const char *const names[] = {
+        ":/data/properties.srx",
+        ":/data/properties.srj",
+        ":/data/properties.tsv",
+        ":/data/properties.csv"
+    };
+    QFile file(names[format]);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return QByteArray();
+    }
+    return file.readAll();
+}
+
+// Feeds the data in chunks the size of a network read, like ParserWorker
+static SparqlQuery::Results parse(SparqlResultsParser::Format format,
+                                  const QByteArray &data, QString *error)
+{
+    const int chunk = 16 * 1024;
+    QScopedPointer<SparqlResultsParser> parser(
+                SparqlResultsParser::create(format));
+    for (int pos = 0; pos < data.size(); pos += chunk) {
+        parser->addData(data.mid(pos, chunk));
+    }
+    parser->finish();
+    if (parser->hasError()) {
+        *error = parser->errorString();
+    }
+    return parser->takeResults();
+}
+
+class TestResultsParser : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void formatsAgree_data();
+    void formatsAgree();
+    void benchmark_data();
+    void benchmark();
+
+private:
+    void addFormats();
+};
+
+void TestResultsParser::addFormats()
+{
+    QTest::addColumn<SparqlResultsParser::Format>("format");
+
+    QTest::newRow("json") << SparqlResultsParser::Json;
+    QTest::newRow("xml") << SparqlResultsParser::Xml;
+    QTest::newRow("tsv") << SparqlResultsParser::Tsv;
+    QTest::newRow("csv") << SparqlResultsParser::Csv;
+}
+
+void TestResultsParser::formatsAgree_data()
+{
+    addFormats();
+}
+
+// JSON is the reference, the others must yield the same strings
+void TestResultsParser::formatsAgree()
+{
+    QFETCH(SparqlResultsParser::Format, format);
+
+    QString error;
+    auto expected = parse(SparqlResultsParser::Json,
+                          fixture(SparqlResultsParser::Json), &error);
+    QVERIFY(error.isEmpty());
+    QCOMPARE(expected.variables, QStringList() << "s" << "p" << "o");
+    QVERIFY(expected.values.size() > 3000);
+
+    auto data = fixture(format);
+    QVERIFY(!data.isEmpty());
+    auto results = parse(format, data, &error);
+    QVERIFY2(error.isEmpty(), qPrintable(error));
+    QCOMPARE(results.variables, expected.variables);
+    QCOMPARE(results.values.size(), expected.values.size());
+    for (int i = 0; i < results.values.size(); i++) {
+        QCOMPARE(results.values[i], expected.values[i]);
+    }
+}
+
+void TestResultsParser::benchmark_data()
+{
+    addFormats();
+}
+
+// Parse time per format, for the preference order in acceptHeader()
+void TestResultsParser::benchmark()
+{
+    QFETCH(SparqlResultsParser::Format, format);
+
+    auto data = fixture(format);
+    QVERIFY(!data.isEmpty());
+
+    QString error;
+    int values = 0;
+    QBENCHMARK {
+        values = parse(format, data, &error).values.size();
+    }
+    QVERIFY2(error.isEmpty(), qPrintable(error));
+    QVERIFY(values > 0);
+}
+
+QTEST_MAIN(TestResultsParser)
+
+#include "tst_resultsparser.moc"
@@ -0,0 +1,7 @@
+TEMPLATE = subdirs
+
+SUBDIRS += crossings \
+    resultsparser \
+    rdffileloader \
+    dateextractor \
+    loadtest
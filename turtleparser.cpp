@@ -0,0 +1,516 @@
+#include "turtleparser.h"
+#include "sparqlresultsparser.h"
+
+#include <QStringList>
+#include <QUrl>
+
+#include <string.h>
+
+static const QString rdfType("http://www.w3.org/1999/02/22-rdf-syntax-ns#type");
+
+static bool isSpace(char c)
+{
+    return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+}
+
+static bool isDelimiter(char c)
+{
+    return isSpace(c) || (c && strchr("<>\"'{}|^`;,[]()#", c));
+}
+
+TurtleParser::TurtleParser(const QSet<QString> &predicates)
+    : predicates(predicates), pos(0), line(1), last(false),
+      state(Subject), collectionDepth(0), directiveHasDot(false),
+      blankNodes(0)
+{
+}
+
+void TurtleParser::addData(const QByteArray &data)
+{
+    buf.remove(0, pos);
+    pos = 0;
+    buf.append(data);
+    parse();
+}
+
+void TurtleParser::finish()
+{
+    last = true;
+    parse();
+    if (!hasError() && (state != Subject || !stack.isEmpty() ||
+                        collectionDepth > 0))
+    {
+        fail("Unexpected end of file");
+    }
+}
+
+SparqlQuery::Results TurtleParser::takeResults()
+{
+    static const QStringList variables = QStringList() << "s" << "p" << "o";
+
+    SparqlQuery::Results results;
+    results.variables = variables;
+    results.values.swap(values);
+    return results;
+}
+
+void TurtleParser::parse()
+{
+    while (!hasError()) {
+        int start = pos;
+        qint64 startLine = line;
+
+        Token t;
+        auto status = nextToken(t);
+        if (status == NeedMore) {
+            pos = start;
+            line = startLine;
+            return;
+        }
+        if (status != Ok || !process(t)) {
+            return;
+        }
+    }
+}
+
+TurtleParser::Status TurtleParser::fail(const QString &err)
+{
+    error = QString("Line %1: %2").arg(line).arg(err);
+    return Error;
+}
+
+// End of a name, prefixed name or number; -1 if it may continue
+int TurtleParser::nameEnd(int from) const
+{
+    const char *s = buf.constData();
+    int size = buf.size();
+
+    int i = from;
+    while (i < size) {
+        char c = s[i];
+        if (c == '\\') {
+            i += 2;
+            continue;
+        }
+        if (isDelimiter(c)) {
+            break;
+        }
+        if (c == '.') {
+            // A trailing dot ends the statement
+            if (i + 1 == size) {
+                if (!last) {
+                    return -1;
+                }
+                break;
+            }
+            if (isDelimiter(s[i + 1]) || s[i + 1] == '.') {
+                break;
+            }
+        }
+        i++;
+    }
+    if (i >= size && !last) {
+        return -1;
+    }
+    return qMin(i, size);
+}
+
+TurtleParser::Status TurtleParser::nextToken(Token &t)
+{
+    const char *s = buf.constData();
+    int size = buf.size();
+
+    while (pos < size) {
+        char c = s[pos];
+        if (c == '\n') {
+            line++;
+            pos++;
+        } else if (isSpace(c)) {
+            pos++;
+        } else if (c == '#') {
+            int end = buf.indexOf('\n', pos);
+            if (end < 0) {
+                if (!last) {
+                    return NeedMore;
+                }
+                end = size;
+            }
+            pos = end;
+        } else {
+            break;
+        }
+    }
+    if (pos == size) {
+        return last ? EndOfData : NeedMore;
+    }
+
+    char c = s[pos];
+    switch (c) {
+    case '<': {
+        int end = buf.indexOf('>', pos + 1);
+        if (end < 0) {
+            return last ? fail("Unterminated IRI") : NeedMore;
+        }
+        t.type = Iri;
+        t.value = resolve(SparqlResultsParser::unescape(s + pos + 1, s + end));
+        pos = end + 1;
+        return Ok;
+    }
+    case '"':
+    case '\'': {
+        if (size - pos < 3 && !last) {
+            return NeedMore;
+        }
+        bool longString = size - pos >= 3 && s[pos + 1] == c &&
+                s[pos + 2] == c;
+        int begin = pos + (longString ? 3 : 1);
+        int newlines = 0;
+        int end = -1;
+        for (int i = begin; i < size; i++) {
+            if (s[i] == '\\') {
+                i++;
+            } else if (s[i] == '\n') {
+                if (!longString) {
+                    return fail("Newline in string");
+                }
+                newlines++;
+            } else if (s[i] == c) {
+                if (!longString) {
+                    end = i;
+                    break;
+                }
+                if (i + 3 > size) {
+                    break;
+                }
+                if (s[i + 1] == c && s[i + 2] == c) {
+                    // Up to two quotes may precede the closing ones
+                    if (i + 3 == size && !last) {
+                        break;
+                    }
+                    if (i + 3 < size && s[i + 3] == c) {
+                        continue;
+                    }
+                    end = i;
+                    break;
+                }
+            }
+        }
+        if (end < 0) {
+            return last ? fail("Unterminated string") : NeedMore;
+        }
+        t.type = Literal;
+        t.value = SparqlResultsParser::unescape(s + begin, s + end);
+        pos = end + (longString ? 3 : 1);
+        line += newlines;
+        return Ok;
+    }
+    case '_': {
+        if (size - pos < 2 && !last) {
+            return NeedMore;
+        }
+        if (size - pos < 2 || s[pos + 1] != ':') {
+            return fail("Invalid blank node");
+        }
+        int end = nameEnd(pos + 2);
+        if (end < 0) {
+            return NeedMore;
+        }
+        t.type = BlankNode;
+        t.value = QString::fromUtf8(s + pos, end - pos);
+        pos = end;
+        return Ok;
+    }
+    case '@': {
+        int end = nameEnd(pos + 1);
+        if (end < 0) {
+            return NeedMore;
+        }
+        t.type = AtWord;
+        t.value = QString::fromLatin1(s + pos + 1, end - pos - 1);
+        pos = end;
+        return Ok;
+    }
+    case '^':
+        if (size - pos < 2 && !last) {
+            return NeedMore;
+        }
+        if (size - pos < 2 || s[pos + 1] != '^') {
+            return fail("Invalid datatype");
+        }
+        t.type = Datatype;
+        t.value = "^^";
+        pos += 2;
+        return Ok;
+    case '.':
+    case ';':
+    case ',':
+    case '[':
+    case ']':
+    case '(':
+    case ')':
+        t.type = Punct;
+        t.punct = c;
+        pos++;
+        return Ok;
+    default:
+        break;
+    }
+
+    int end = nameEnd(pos);
+    if (end < 0) {
+        return NeedMore;
+    }
+    if (end == pos) {
+        return fail(QString("Unexpected character '%1'").arg(QLatin1Char(c)));
+    }
+    t.value = QString::fromUtf8(s + pos, end - pos);
+    pos = end;
+
+    if (t.value == "a") {
+        t.type = Keyword;
+    } else if (t.value == "true" || t.value == "false" ||
+               (c >= '0' && c <= '9') || c == '+' || c == '-')
+    {
+        t.type = Literal;
+    } else if (t.value.compare("PREFIX", Qt::CaseInsensitive) == 0 ||
+               t.value.compare("BASE", Qt::CaseInsensitive) == 0)
+    {
+        t.type = Keyword;
+        t.value = t.value.toUpper();
+    } else if (t.value.contains(':')) {
+        t.type = PrefixedName;
+    } else {
+        return fail("Unexpected " + t.value);
+    }
+    return Ok;
+}
+
+bool TurtleParser::process(const Token &t)
+{
+    // Items of collections are skipped, the collection itself is a node
+    if (collectionDepth > 0) {
+        if (t.type == Punct && t.punct == '(') {
+            collectionDepth++;
+        } else if (t.type == Punct && t.punct == ')') {
+            if (--collectionDepth == 0) {
+                return term(newBlankNode(), false);
+            }
+        }
+        return true;
+    }
+
+    switch (t.type) {
+    case Iri:
+        if (state == PrefixIri) {
+            prefixes[directivePrefix] = t.value;
+            state = directiveHasDot ? DirectiveEnd : Subject;
+            return true;
+        }
+        if (state == BaseIri) {
+            base = t.value;
+            state = directiveHasDot ? DirectiveEnd : Subject;
+            return true;
+        }
+        return term(t.value, false);
+
+    case PrefixedName: {
+        if (state == PrefixName) {
+            if (!t.value.endsWith(':')) {
+                fail("Invalid prefix " + t.value);
+                return false;
+            }
+            directivePrefix = t.value.left(t.value.size() - 1);
+            state = PrefixIri;
+            return true;
+        }
+        QString iri;
+        return expand(t.value, iri) && term(iri, false);
+    }
+
+    case BlankNode:
+        return term(t.value, false);
+
+    case Literal:
+        return term(t.value, true);
+
+    case Datatype:
+        if (state != AfterObject) {
+            break;
+        }
+        state = DatatypeIri;
+        return true;
+
+    case AtWord:
+        if (state == Subject && (t.value == "prefix" || t.value == "base")) {
+            directiveHasDot = true;
+            state = t.value == "prefix" ? PrefixName : BaseIri;
+            return true;
+        }
+        // Language tag
+        if (state == AfterObject) {
+            return true;
+        }
+        break;
+
+    case Keyword:
+        if (t.value == "a" && state == Predicate) {
+            predicate = rdfType;
+            state = Object;
+            return true;
+        }
+        if (state == Subject && (t.value == "PREFIX" || t.value == "BASE")) {
+            directiveHasDot = false;
+            state = t.value == "PREFIX" ? PrefixName : BaseIri;
+            return true;
+        }
+        break;
+
+    case Punct:
+        switch (t.punct) {
+        case '[':
+            if (state != Subject && state != Object) {
+                break;
+            }
+            {
+                Frame f;
+                f.subject = subject;
+                f.predicate = predicate;
+                f.state = state;
+                stack.append(f);
+            }
+            subject = newBlankNode();
+            if (state == Object) {
+                addTriple(stack.last().subject, stack.last().predicate,
+                          subject);
+            }
+            state = Predicate;
+            return true;
+        case ']': {
+            if (stack.isEmpty() || (state != Predicate && state != AfterObject)) {
+                break;
+            }
+            Frame f = stack.last();
+            stack.removeLast();
+            if (f.state == Subject) {
+                state = Predicate;
+            } else {
+                subject = f.subject;
+                predicate = f.predicate;
+                state = AfterObject;
+            }
+            return true;
+        }
+        case '(':
+            if (state != Subject && state != Object) {
+                break;
+            }
+            collectionDepth = 1;
+            return true;
+        case ',':
+            if (state != AfterObject) {
+                break;
+            }
+            state = Object;
+            return true;
+        case ';':
+            if (state != AfterObject && state != Predicate) {
+                break;
+            }
+            state = Predicate;
+            return true;
+        case '.':
+            if (state == DirectiveEnd ||
+                    (stack.isEmpty() &&
+                     (state == AfterObject || state == Predicate)))
+            {
+                state = Subject;
+                return true;
+            }
+            break;
+        }
+        fail(QString("Unexpected '%1'").arg(QLatin1Char(t.punct)));
+        return false;
+    }
+
+    fail("Unexpected " + t.value);
+    return false;
+}
+
+bool TurtleParser::term(const QString &value, bool literal)
+{
+    switch (state) {
+    case Subject:
+        if (literal) {
+            break;
+        }
+        subject = value;
+        state = Predicate;
+        return true;
+    case Predicate:
+        if (literal) {
+            break;
+        }
+        predicate = value;
+        state = Object;
+        return true;
+    case Object:
+        addTriple(subject, predicate, value);
+        state = AfterObject;
+        return true;
+    case DatatypeIri:
+        state = AfterObject;
+        return true;
+    default:
+        break;
+    }
+    fail("Unexpected " + value);
+    return false;
+}
+
+bool TurtleParser::expand(const QString &name, QString &iri)
+{
+    int colon = name.indexOf(':');
+    auto found = prefixes.constFind(name.left(colon));
+    if (found == prefixes.constEnd()) {
+        fail("Undefined prefix in " + name);
+        return false;
+    }
+
+    iri = *found;
+    auto local = name.mid(colon + 1);
+    for (int i = 0; i < local.size(); i++) {
+        if (local[i] == '\\') {
+            local.remove(i, 1);
+        }
+    }
+    iri.append(local);
+    return true;
+}
+
+QString TurtleParser::resolve(const QString &iri) const
+{
+    if (base.isEmpty()) {
+        return iri;
+    }
+    int colon = iri.indexOf(':');
+    if (colon > 0) {
+        int slash = iri.indexOf('/');
+        if (slash < 0 || colon < slash) {
+            return iri;
+        }
+    }
+    return QUrl(base).resolved(QUrl(iri)).toString();
+}
+
+QString TurtleParser::newBlankNode()
+{
+    return "_:node" + QString::number(++blankNodes);
+}
+
+void TurtleParser::addTriple(const QString &s, const QString &p,
+                             const QString &o)
+{
+    if (predicates.contains(p)) {
+        values << s << p << o;
+    }
+}
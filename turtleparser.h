@@ -0,0 +1,110 @@
+#ifndef TURTLEPARSER_H
+#define TURTLEPARSER_H
+
+#include <QSet>
+#include <QHash>
+#include <QVector>
+
+#include "sparqlquery.h"
+
+// Turtle subset large dumps are written in: directives, IRIs, prefixed
+// names, blank nodes, literals, predicate and object lists, nested blank
+// node property lists. Collections are consumed but their items ignored.
+// N-Triples is a subset of it.
+class TurtleParser
+{
+public:
+    explicit TurtleParser(const QSet<QString> &predicates);
+
+    // Parses complete statements, keeps incomplete tail
+    void addData(const QByteArray &);
+    // No more data will arrive
+    void finish();
+
+    bool hasError() const { return !error.isEmpty(); }
+    const QString &errorString() const { return error; }
+
+    SparqlQuery::Results takeResults();
+
+private:
+    enum TokenType
+    {
+        Iri,
+        PrefixedName,
+        BlankNode,
+        Literal,
+        AtWord,
+        Datatype,
+        Keyword,
+        Punct
+    };
+
+    struct Token
+    {
+        TokenType type;
+        QString value;
+        char punct;
+    };
+
+    enum Status
+    {
+        Ok,
+        NeedMore,
+        EndOfData,
+        Error
+    };
+
+    enum State
+    {
+        Subject,
+        Predicate,
+        Object,
+        AfterObject,
+        DatatypeIri,
+        PrefixName,
+        PrefixIri,
+        BaseIri,
+        DirectiveEnd
+    };
+
+    struct Frame
+    {
+        QString subject, predicate;
+        State state;
+    };
+
+    void parse();
+    Status nextToken(Token &);
+    int nameEnd(int from) const;
+    Status fail(const QString &);
+
+    bool process(const Token &);
+    bool term(const QString &, bool literal);
+    bool expand(const QString &name, QString &iri);
+    QString resolve(const QString &iri) const;
+    QString newBlankNode();
+    void addTriple(const QString &s, const QString &p, const QString &o);
+
+    QSet<QString> predicates;
+    QVector<QString> values;
+
+    QByteArray buf;
+    int pos;
+    qint64 line;
+    bool last;
+
+    State state;
+    QString subject, predicate;
+    QVector<Frame> stack;
+    int collectionDepth;
+    bool directiveHasDot;
+    QString directivePrefix;
+
+    QHash<QString, QString> prefixes;
+    QString base;
+    quint64 blankNodes;
+
+    QString error;
+};
+
+#endif // TURTLEPARSER_H
@@ -21,17 +21,16 @@ struct VNode : public QSharedData
 
     QVector<VNodeRef> neighbors[2];
     QHash<VNodeRef, QColor> edgeColors;
+    // Node id in LayeredGraph::Layer, set by LayeredGraph::build()
     int indexInLayer;
 
     bool updated;
     bool moveable;
 
     QPair<QString, int> currentLayer;
-    qreal x, y, size, newY;
+    qreal x, y, size;
     QString label;
     QColor color;
-
-    QVector<int> neighborIndices[2];
 };
 
 inline uint qHash(const VNodeRef &ref)
@@ -0,0 +1,24 @@
+#include "workerthread.h"
+
+Q_GLOBAL_STATIC(WorkerThread, worker)
+
+WorkerThread::WorkerThread(QObject *parent)
+    : QThread(parent)
+{
+    setObjectName("Worker");
+}
+
+WorkerThread::~WorkerThread()
+{
+    quit();
+    wait();
+}
+
+QThread *WorkerThread::instance()
+{
+    auto thread = worker();
+    if (!thread->isRunning()) {
+        thread->start(QThread::LowPriority);
+    }
+    return thread;
+}
@@ -0,0 +1,19 @@
+#ifndef WORKERTHREAD_H
+#define WORKERTHREAD_H
+
+#include <QThread>
+
+// Shared background thread for result parsing and dataset assembly.
+// Objects are moved to it with moveToThread() and talk to the GUI
+// thread through queued signals only.
+class WorkerThread : public QThread
+{
+    Q_OBJECT
+public:
+    explicit WorkerThread(QObject *parent = 0);
+    virtual ~WorkerThread();
+
+    static QThread *instance();
+};
+
+#endif // WORKERTHREAD_H